@@ -8,6 +8,10 @@
 #include <vector>
 #include <iostream>
 #include <cstdio>
+#include <thread>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
 // test cases
 unsigned int testMemoryLeaksNoShutdown();
 unsigned int testSimpleFirstFit();
@@ -19,6 +23,23 @@ unsigned int testRepeatedShutdown();
 unsigned int testMaxInitialization();
 unsigned int testGetters();
 unsigned int testReadingUsingGetMemoryStart();
+unsigned int testPlacementPolicy();
+unsigned int testAdaptivePolicy();
+unsigned int testNextFit();
+unsigned int testBuddyAllocator();
+unsigned int testDeferredFree();
+unsigned int testSmallClass();
+unsigned int testNumaPartitions();
+unsigned int testSharedArena();
+unsigned int testOffsetApi();
+unsigned int testFileArena();
+unsigned int testChangeTracking();
+unsigned int testHardening();
+unsigned int testHeapProfile();
+unsigned int testZeroedAllocation();
+unsigned int testMemoryResource();
+unsigned int testAsyncAllocation();
+unsigned int testMemoryPressure();
 
 
 // helper functions
@@ -31,6 +52,7 @@ unsigned int testDumpMemoryMap(MemoryManager& memoryManager, std::string fileNam
 
 extern int bestFit(int sizeInWords, void* list);
 extern int worstFit(int sizeInWords, void* list);
+extern int firstFit(int sizeInWords, void* list);
 
 int hopesAndDreamsAllocator(int sizeInWords, void* list)
 {
@@ -78,9 +100,24 @@ int hopesAndDreamsAllocator(int sizeInWords, void* list)
     return wordOffset;
 }
 
+// Typed policy that takes the lowest-addressed hole that fits and stops there
+class LowestHolePolicy : public PlacementPolicy
+{
+public:
+    int place(size_t sizeInWords, const HoleView& holes) override
+    {
+        for(Hole hole : holes) {
+            if(hole.length >= sizeInWords) {
+                return static_cast<int>(hole.offset);
+            }
+        }
+        return -1;
+    }
+};
+
 int main()
 {
-    unsigned int maxScore = 38;
+    unsigned int maxScore = 88;
     unsigned int score = 0;
     
     int tmp = testMemoryLeaksNoShutdown();
@@ -123,7 +160,75 @@ int main()
 
     tmp = 5 * testReadingUsingGetMemoryStart();
 	score += tmp; // 1 * 5
-	std::cout << "Completed testReadingUsingGetMemoryStart. Final Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+	std::cout << "Completed testReadingUsingGetMemoryStart. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testPlacementPolicy();
+	score += tmp; // 2
+	std::cout << "Completed testPlacementPolicy. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testAdaptivePolicy();
+	score += tmp; // 3
+	std::cout << "Completed testAdaptivePolicy. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testNextFit();
+	score += tmp; // 1
+	std::cout << "Completed testNextFit. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testBuddyAllocator();
+	score += tmp; // 3
+	std::cout << "Completed testBuddyAllocator. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testDeferredFree();
+	score += tmp; // 3
+	std::cout << "Completed testDeferredFree. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testSmallClass();
+	score += tmp; // 3
+	std::cout << "Completed testSmallClass. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testNumaPartitions();
+	score += tmp; // 3
+	std::cout << "Completed testNumaPartitions. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testSharedArena();
+	score += tmp; // 3
+	std::cout << "Completed testSharedArena. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testOffsetApi();
+	score += tmp; // 3
+	std::cout << "Completed testOffsetApi. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testFileArena();
+	score += tmp; // 3
+	std::cout << "Completed testFileArena. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testChangeTracking();
+	score += tmp; // 3
+	std::cout << "Completed testChangeTracking. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testHardening();
+	score += tmp; // 6
+	std::cout << "Completed testHardening. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testHeapProfile();
+	score += tmp; // 2
+	std::cout << "Completed testHeapProfile. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testZeroedAllocation();
+	score += tmp; // 3
+	std::cout << "Completed testZeroedAllocation. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testMemoryResource();
+	score += tmp; // 2
+	std::cout << "Completed testMemoryResource. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testAsyncAllocation();
+	score += tmp; // 5
+	std::cout << "Completed testAsyncAllocation. Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
+
+    tmp = testMemoryPressure();
+	score += tmp; // 2
+	std::cout << "Completed testMemoryPressure. Final Score: " << std::dec << score << " / " << std::dec << maxScore << std::endl;
 
 	// Additional debug statements for memory management
 	std::cout << "\nStarting additional memory management tests...\n";
@@ -178,7 +283,7 @@ unsigned int testSimpleFirstFit()
 
     unsigned int wordSize = 8;
     size_t numberOfWords = 26;
-    MemoryManager memoryManager(wordSize, bestFit);
+    MemoryManager memoryManager(wordSize, firstFit);
     memoryManager.initialize(numberOfWords);
 
     std::cout << "Memory initialized with limit: " << memoryManager.getMemoryLimit() << " bytes" << std::endl;
@@ -623,6 +728,1168 @@ unsigned int testReadingUsingGetMemoryStart()
 }
 
 
+unsigned int testPlacementPolicy()
+{
+    std::cout << "Test Case: typed placement policy" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 26;
+    MemoryManager memoryManager(wordSize, std::unique_ptr<PlacementPolicy>(new LowestHolePolicy()));
+    memoryManager.initialize(numberOfWords);
+
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 10));
+    memoryManager.allocate(sizeof(uint64_t) * 2);
+    uint64_t* testArray3 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 2));
+    memoryManager.allocate(sizeof(uint64_t) * 6);
+
+    // adjacent blocks must be freed one at a time
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray3);
+
+    unsigned int score = 0;
+
+    std::vector<uint16_t> correctList = {0, 10, 12, 2, 20, 6};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    // the lowest hole is reused first
+    uint64_t* testArray5 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 2));
+    std::vector<uint16_t> correctListAfter = {2, 8, 12, 2, 20, 6};
+    if(testArray5 == testArray1) {
+        score += testGetList(memoryManager, correctListAfter.size() / 2, correctListAfter);
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testAdaptivePolicy()
+{
+    std::cout << "Test Case: adaptive policy switches after failures" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 34;
+
+    // sizes above 4 words are large; every request is its own window and one failure switches
+    AdaptivePolicy* adaptive = new AdaptivePolicy(4, 1, 1);
+    MemoryManager memoryManager(wordSize, std::unique_ptr<PlacementPolicy>(adaptive));
+    memoryManager.initialize(numberOfWords);
+
+    // holes of 12 and 20 words separated by pinned words
+    void* slot1 = memoryManager.allocate(wordSize * 12);
+    memoryManager.allocate(wordSize * 1);
+    void* slot2 = memoryManager.allocate(wordSize * 20);
+    memoryManager.allocate(wordSize * 1);
+    memoryManager.free(slot1);
+    memoryManager.free(slot2);
+
+    unsigned int score = 0;
+
+    // best fit puts 8 words in the 12 word hole and cannot place the second 12
+    void* header = memoryManager.allocate(wordSize * 8);
+    void* payload1 = memoryManager.allocate(wordSize * 12);
+    void* payload2 = memoryManager.allocate(wordSize * 12);
+    std::cout << "Expected: worstFit" << std::endl;
+    std::cout << "Got:" << adaptive->activePolicy(8) << std::endl;
+    if(payload2 == nullptr && std::string(adaptive->activePolicy(8)) == "worstFit") {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+    memoryManager.free(header);
+    memoryManager.free(payload1);
+
+    // worst fit leaves a 12 word remainder in the 20 word hole
+    header = memoryManager.allocate(wordSize * 8);
+    payload1 = memoryManager.allocate(wordSize * 12);
+    payload2 = memoryManager.allocate(wordSize * 12);
+    if(header && payload1 && payload2) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    // requests larger than the arena fail under every candidate with the same score;
+    // once all are tried, a tie keeps the active one
+    AdaptivePolicy* tied = new AdaptivePolicy(4, 1, 1);
+    MemoryManager tiedManager(wordSize, std::unique_ptr<PlacementPolicy>(tied));
+    tiedManager.initialize(numberOfWords);
+    for(int i = 0; i < 4; ++i) {
+        tiedManager.allocate(wordSize * (numberOfWords + 1));
+    }
+    std::cout << "Expected: 3 switches, nextFit" << std::endl;
+    std::cout << "Got: " << tied->switches() << " switches, " << tied->activePolicy(8) << std::endl;
+    if(tied->switches() == 3 && std::string(tied->activePolicy(8)) == "nextFit") {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+    tiedManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testNextFit()
+{
+    std::cout << "Test Case: next fit resumes after the last placement" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 26;
+    MemoryManager memoryManager(wordSize, std::unique_ptr<PlacementPolicy>(new NextFitPolicy()));
+    memoryManager.initialize(numberOfWords);
+
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 4));
+    uint64_t* testArray2 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 4));
+    uint64_t* testArray3 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 4));
+    memoryManager.free(testArray1);
+
+    // the hole at 0 is skipped, the search starts after testArray3
+    uint64_t* testArray4 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 2));
+
+    std::vector<uint16_t> correctList = {0, 4, 14, 12};
+    unsigned int score = testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    memoryManager.free(testArray2);
+    memoryManager.free(testArray3);
+    memoryManager.free(testArray4);
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testBuddyAllocator()
+{
+    std::cout << "Test Case: buddy allocator, 26 words = 16 + 8 + 2" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 26;
+    MemoryManager memoryManager(wordSize, bestFit);
+    memoryManager.initialize(numberOfWords, AllocationMode::Buddy);
+
+    // 3 words round up to 4, split from the 8 word block at 16
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 3));
+
+    unsigned int score = 0;
+
+    std::vector<uint16_t> correctList = {0, 16, 20, 6};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    MemoryStats stats = memoryManager.getStats();
+    std::cout << "Expected: used 4, requested 3" << std::endl;
+    std::cout << "Got: used " << stats.usedWords << ", requested " << stats.requestedWords << std::endl;
+    if(stats.usedWords == 4 && stats.requestedWords == 3) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // freeing merges the block back with its buddy
+    memoryManager.free(testArray1);
+    std::vector<uint16_t> correctListAfterFree = {0, 26};
+    score += testDumpMemoryMap(memoryManager, "testBuddyAllocator.txt", vectorToString(correctListAfterFree));
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testDeferredFree()
+{
+    std::cout << "Test Case: deferred free" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 26;
+    MemoryManager memoryManager(wordSize, bestFit);
+    memoryManager.initialize(numberOfWords);
+    memoryManager.setDeferredFree(true);
+
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 4));
+    uint64_t* testArray2 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 4));
+    uint64_t* testArray3 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 18));
+
+    unsigned int score = 0;
+
+    // queued frees leave the map untouched until maintain() merges them into one hole
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray2);
+    MemoryStats stats = memoryManager.getStats();
+    size_t released = memoryManager.maintain();
+    std::vector<uint16_t> correctList = {0, 8};
+    std::cout << "Expected: 2 pending, 2 released" << std::endl;
+    std::cout << "Got: " << stats.pendingFrees << " pending, " << released << " released" << std::endl;
+    if(stats.pendingFrees == 2 && stats.usedWords == 26 && released == 2) {
+        score += testGetList(memoryManager, correctList.size() / 2, correctList);
+    }
+
+    // an allocation that does not fit drains the queue before giving up
+    memoryManager.free(testArray3);
+    uint64_t* testArray4 = static_cast<uint64_t*>(memoryManager.allocate(sizeof(uint64_t) * 20));
+    if(testArray4 == testArray1) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // producers free from several threads while the maintenance thread drains
+    memoryManager.startMaintenanceThread(std::chrono::milliseconds(1));
+    std::vector<std::thread> workers;
+    for(int t = 0; t < 4; ++t) {
+        workers.emplace_back([&memoryManager]() {
+            for(int i = 0; i < 2000; ++i) {
+                void* block = memoryManager.allocate(8);
+                memoryManager.free(block);
+            }
+        });
+    }
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+    memoryManager.stopMaintenanceThread();
+    memoryManager.setDeferredFree(false);
+
+    stats = memoryManager.getStats();
+    std::cout << "Expected: 20 used words, 0 pending" << std::endl;
+    std::cout << "Got: " << stats.usedWords << " used words, " << stats.pendingFrees << " pending" << std::endl;
+    if(stats.usedWords == 20 && stats.pendingFrees == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testSmallClass()
+{
+    std::cout << "Test Case: lock-free small class" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 32;
+    MemoryManager memoryManager(wordSize, bestFit);
+    memoryManager.initialize(numberOfWords);
+
+    // 8 slots of 2 words at the start of the arena
+    memoryManager.enableSmallClass(16, 8);
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(16));
+    uint64_t* testArray2 = static_cast<uint64_t*>(memoryManager.allocate(8));
+    uint64_t* testArray3 = static_cast<uint64_t*>(memoryManager.allocate(24)); // too big, comes from the arena
+    memoryManager.free(testArray1);
+
+    unsigned int score = 0;
+
+    // slot 1 in use, slots 0 and 2-7 free, then the 3 word block at 16
+    std::vector<uint8_t> correctBitmap{0x0C, 0x00, 0x07, 0x00};
+    uint8_t* bitmap = static_cast<uint8_t*>(memoryManager.getBitmap());
+    std::vector<uint8_t> gotBitmap(bitmap + 2, bitmap + 2 + correctBitmap.size());
+    delete [] bitmap;
+    if(gotBitmap == correctBitmap) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT] bitmap mismatch\n" << std::endl;
+    }
+
+    std::vector<uint16_t> correctList = {19, 13};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+    memoryManager.free(testArray2);
+    memoryManager.free(testArray3);
+
+    // threads race for slots; every slot must come back and none may be handed out twice
+    std::atomic<int> doubleClaims(0);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < 8; ++t) {
+        workers.emplace_back([&memoryManager, &doubleClaims, t]() {
+            for(int i = 0; i < 5000; ++i) {
+                uint64_t* slot = static_cast<uint64_t*>(memoryManager.allocate(16));
+                if(slot == nullptr) {
+                    continue;
+                }
+                slot[0] = t;
+                slot[1] = i;
+                if(slot[0] != static_cast<uint64_t>(t) || slot[1] != static_cast<uint64_t>(i)) {
+                    ++doubleClaims;
+                }
+                memoryManager.free(slot);
+            }
+        });
+    }
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+
+    MemoryStats stats = memoryManager.getStats();
+    std::cout << "Expected: 0 slots in use, 0 double claims" << std::endl;
+    std::cout << "Got: " << stats.smallClassSlotsInUse << " slots in use, " << doubleClaims << " double claims" << std::endl;
+    if(stats.smallClassSlots == 8 && stats.smallClassSlotsInUse == 0 && doubleClaims == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testNumaPartitions()
+{
+    std::cout << "Test Case: NUMA partitions" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 32;
+    MemoryManager memoryManager(wordSize, bestFit);
+
+    // Two nodes are forced so the split shows up on any machine; every CPU
+    // here maps to node 0, so node 1 only ever serves remote allocations
+    InitOptions options;
+    options.numa = true;
+    options.numaNodes = 2;
+    memoryManager.initialize(numberOfWords, options);
+
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(80)); // node 0
+    uint64_t* testArray2 = static_cast<uint64_t*>(memoryManager.allocate(64)); // does not fit in node 0
+
+    unsigned int score = 0;
+
+    MemoryStats stats = memoryManager.getStats();
+    std::cout << "Expected: offset 16, 1 local on node 0, 1 remote on node 1" << std::endl;
+    std::cout << "Got: offset " << (reinterpret_cast<char*>(testArray2) - static_cast<char*>(memoryManager.getMemoryStart())) / wordSize
+              << ", " << (stats.nodes.empty() ? 0 : stats.nodes[0].localAllocations) << " local on node 0, "
+              << (stats.nodes.size() < 2 ? 0 : stats.nodes[1].remoteAllocations) << " remote on node 1" << std::endl;
+    if(stats.nodes.size() == 2 && testArray2 == testArray1 + 16 &&
+       stats.nodes[0].localAllocations == 1 && stats.nodes[1].remoteAllocations == 1 &&
+       stats.nodes[0].usedWords == 10 && stats.nodes[1].usedWords == 8) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // freed partitions stay separate holes
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray2);
+    std::vector<uint16_t> correctList = {0, 16, 16, 16};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    // a deferred drain does not merge neighbours across the partition boundary
+    memoryManager.setDeferredFree(true);
+    testArray1 = static_cast<uint64_t*>(memoryManager.allocate(128));
+    testArray2 = static_cast<uint64_t*>(memoryManager.allocate(128));
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray2);
+    memoryManager.maintain();
+    memoryManager.setDeferredFree(false);
+    void* testArray3 = memoryManager.allocate(160); // 20 words, more than a partition
+    stats = memoryManager.getStats();
+    std::cout << "Expected: 2 holes, 0 and 0 used, no 20 word block" << std::endl;
+    std::cout << "Got: " << stats.holeCount << " holes, " << stats.nodes[0].usedWords << " and " << stats.nodes[1].usedWords
+              << " used, " << (testArray3 ? "a" : "no") << " 20 word block" << std::endl;
+    if(stats.holeCount == 2 && stats.nodes[0].usedWords == 0 && stats.nodes[1].usedWords == 0 && testArray3 == nullptr) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testSharedArena()
+{
+    std::cout << "Test Case: shared arena" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 16;
+    std::string name = "/MemoryManagerTest-" + std::to_string(getpid());
+    MemoryManager memoryManager(wordSize, firstFit);
+
+    InitOptions options;
+    options.sharedName = name.c_str();
+    memoryManager.initialize(numberOfWords, options);
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(32));
+
+    unsigned int score = 0;
+
+    // a second process attaches, takes the next block and writes into it
+    pid_t child = fork();
+    if(child == 0) {
+        MemoryManager childManager(wordSize, firstFit);
+        if(!childManager.attach(name.c_str())) {
+            _exit(1);
+        }
+        uint64_t* testArray2 = static_cast<uint64_t*>(childManager.allocate(16));
+        if(testArray2 != static_cast<uint64_t*>(childManager.getMemoryStart()) + 4) {
+            _exit(2);
+        }
+        testArray2[0] = 0xC0FFEE;
+        _exit(0);
+    }
+    int status = -1;
+    waitpid(child, &status, 0);
+    std::cout << "Expected: child exit 0, 0xc0ffee at word 4" << std::endl;
+    std::cout << "Got: child exit " << (WIFEXITED(status) ? WEXITSTATUS(status) : -1) << ", 0x" << std::hex
+              << testArray1[4] << std::dec << " at word 4" << std::endl;
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0 && testArray1[4] == 0xC0FFEE) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // the child's block is still taken here
+    std::vector<uint16_t> correctList = {6, 10};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    // and can be freed through another mapping of the same segment
+    MemoryManager otherManager(wordSize, firstFit);
+    otherManager.attach(name.c_str());
+    otherManager.free(static_cast<uint64_t*>(otherManager.getMemoryStart()) + 4);
+    correctList = {4, 12};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    otherManager.shutdown();
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+struct OffsetNode {
+    uint64_t value;
+    OffsetPtr<OffsetNode> next;
+};
+
+unsigned int testOffsetApi()
+{
+    std::cout << "Test Case: offset API" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 16;
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initialize(numberOfWords);
+
+    OffsetPtr<OffsetNode> head = OffsetPtr<OffsetNode>::allocate(memoryManager);
+    OffsetPtr<OffsetNode> tail = OffsetPtr<OffsetNode>::allocate(memoryManager);
+    int failed = memoryManager.allocateOffset(0);
+    head.get(memoryManager)->value = 1;
+    head.get(memoryManager)->next = tail;
+    tail.get(memoryManager)->value = 2;
+    tail.get(memoryManager)->next = OffsetPtr<OffsetNode>();
+
+    unsigned int score = 0;
+
+    std::cout << "Expected: offsets 0, 2, -1" << std::endl;
+    std::cout << "Got: offsets " << head.wordOffset() << ", " << tail.wordOffset() << ", " << failed << std::endl;
+    if(head.wordOffset() == 0 && tail.wordOffset() == 2 && failed == -1) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // the list is still walkable in a byte copy of the arena
+    std::vector<char> copy(memoryManager.getMemoryLimit());
+    std::memcpy(copy.data(), memoryManager.getMemoryStart(), copy.size());
+    uint64_t sum = 0;
+    for(OffsetPtr<OffsetNode> node = head; node; node = node.get(copy.data(), wordSize)->next) {
+        sum += node.get(copy.data(), wordSize)->value;
+    }
+    std::cout << "Expected: sum 3" << std::endl;
+    std::cout << "Got: sum " << sum << std::endl;
+    if(sum == 3) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    head.free(memoryManager);
+    std::vector<uint16_t> correctList = {0, 2, 4, 12};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testFileArena()
+{
+    std::cout << "Test Case: file-backed arena" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 16;
+    std::string path = "/tmp/MemoryManagerTest-" + std::to_string(getpid()) + ".arena";
+    std::remove(path.c_str());
+
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initializeFromFile(path.c_str(), numberOfWords);
+    memoryManager.allocateOffset(24);
+    int offset = memoryManager.allocateOffset(16);
+    static_cast<uint64_t*>(memoryManager.getMemoryStart())[offset] = 0xFEED;
+
+    unsigned int score = 0;
+
+    // the file is locked while it is mapped
+    MemoryManager second(wordSize, firstFit);
+    bool busy = second.initializeFromFile(path.c_str(), numberOfWords);
+    std::cout << "Expected: open file refused" << std::endl;
+    std::cout << "Got: open file " << (busy ? "accepted" : "refused") << std::endl;
+    if(!busy) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+    memoryManager.shutdown();
+
+    // a new manager picks up both blocks and the data from the file
+    MemoryManager reopened(wordSize, firstFit);
+    bool wrongSize = reopened.initializeFromFile(path.c_str(), numberOfWords * 2);
+    bool opened = reopened.initializeFromFile(path.c_str(), numberOfWords);
+    uint64_t value = opened ? static_cast<uint64_t*>(reopened.getMemoryStart())[offset] : 0;
+    std::cout << "Expected: wrong size rejected, reopened, 0xfeed at word 3" << std::endl;
+    std::cout << "Got: wrong size " << (wrongSize ? "accepted" : "rejected") << ", " << (opened ? "reopened" : "not reopened")
+              << ", 0x" << std::hex << value << std::dec << " at word " << offset << std::endl;
+    if(!wrongSize && opened && offset == 3 && value == 0xFEED) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    std::vector<uint16_t> correctList = {5, 11};
+    score += testGetList(reopened, correctList.size() / 2, correctList);
+
+    reopened.shutdown();
+    std::remove(path.c_str());
+
+    return score;
+}
+
+
+unsigned int testChangeTracking()
+{
+    std::cout << "Test Case: change tracking" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 2048; // four 512-word chunks
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initialize(numberOfWords);
+    memoryManager.setChangeTracking(true);
+
+    memoryManager.allocate(1100 * wordSize);
+    void* testArray2 = memoryManager.allocate(100 * wordSize);
+    memoryManager.allocate(10 * wordSize);
+
+    unsigned int score = 0;
+
+    // the first delta covers the whole arena
+    BitmapDelta full = memoryManager.getBitmapDelta(0);
+    std::cout << "Expected: 4 chunks" << std::endl;
+    std::cout << "Got: " << full.chunks.size() << " chunks" << std::endl;
+    if(full.chunks.size() == 4) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // freeing words 1100-1199 only touches chunk 2 (words 1024-1535)
+    memoryManager.free(testArray2);
+    BitmapDelta bitmapDelta = memoryManager.getBitmapDelta(full.epoch);
+    bool bitmapCorrect = bitmapDelta.chunks.size() == 1 && bitmapDelta.chunks[0].firstWord == 1024 &&
+                         bitmapDelta.chunks[0].bitmap[0] == 0xFF && // 1024-1031 allocated
+                         !(bitmapDelta.chunks[0].bitmap[76 / 8] & (1 << (76 % 8))) && // 1100 free
+                         (bitmapDelta.chunks[0].bitmap[176 / 8] & (1 << (176 % 8))); // 1200 allocated
+    std::cout << "Expected: 1 chunk at word 1024" << std::endl;
+    std::cout << "Got: " << bitmapDelta.chunks.size() << " chunks"
+              << (bitmapDelta.chunks.empty() ? "" : " at word " + std::to_string(bitmapDelta.chunks[0].firstWord)) << std::endl;
+    if(bitmapCorrect) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    ListDelta listDelta = memoryManager.getListDelta(full.epoch);
+    std::vector<uint16_t> correctList = {1100, 100, 1210, 838};
+    std::vector<uint16_t> gotList;
+    for(Hole hole : listDelta.holes) {
+        gotList.push_back(hole.offset);
+        gotList.push_back(hole.length);
+    }
+    std::cout << "Expected: chunk 2, " << vectorToString(correctList) << std::endl;
+    std::cout << "Got: chunk " << (listDelta.chunks.empty() ? std::string("none") : std::to_string(listDelta.chunks[0]))
+              << ", " << (gotList.empty() ? std::string("[]") : vectorToString(gotList)) << std::endl;
+    if(listDelta.chunks == std::vector<size_t>{2} && gotList == correctList && listDelta.epoch >= bitmapDelta.epoch) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testHardening()
+{
+    std::cout << "Test Case: hardened mode" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 32;
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initialize(numberOfWords);
+
+    std::vector<Violation> reported;
+    HardeningOptions options;
+    options.enabled = true;
+    options.guardWords = 1;
+    options.onViolation = [&reported](Violation violation, size_t) { reported.push_back(violation); };
+    memoryManager.setHardening(options);
+
+    // words 0-3: guard, 2 words, guard
+    uint64_t* testArray1 = static_cast<uint64_t*>(memoryManager.allocate(16));
+    uint64_t* testArray2 = static_cast<uint64_t*>(memoryManager.allocate(8));
+    uint64_t* testArray3 = static_cast<uint64_t*>(memoryManager.allocate(24));
+    testArray1[0] = 1;
+    testArray1[2] = 0; // one word past the end
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray3 + 1);
+    memoryManager.free(testArray3);
+
+    unsigned int score = 0;
+
+    MemoryStats stats = memoryManager.getStats();
+    std::cout << "Expected: offset 1, 3 hardened, 1 guard, 1 double, 1 invalid, 3 reported" << std::endl;
+    std::cout << "Got: offset " << testArray1 - static_cast<uint64_t*>(memoryManager.getMemoryStart()) << ", "
+              << stats.hardenedAllocations << " hardened, " << stats.guardViolations << " guard, "
+              << stats.doubleFrees << " double, " << stats.invalidFrees << " invalid, " << reported.size() << " reported" << std::endl;
+    if(testArray1 == static_cast<uint64_t*>(memoryManager.getMemoryStart()) + 1 && stats.hardenedAllocations == 3 &&
+       stats.guardViolations == 1 && stats.doubleFrees == 1 && stats.invalidFrees == 1 && reported.size() == 3 &&
+       reported[0] == Violation::GuardCorrupted && reported[1] == Violation::DoubleFree && reported[2] == Violation::InvalidFree) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // freed memory is poisoned
+    std::cout << "Expected: 0xdddddddddddddddd" << std::endl;
+    std::cout << "Got: 0x" << std::hex << testArray1[0] << std::dec << std::endl;
+    if(testArray1[0] == 0xDDDDDDDDDDDDDDDDULL) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // the rejected frees left the map alone
+    std::vector<uint16_t> correctList = {0, 4, 7, 25};
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    // a free through the front guard or from inside a word is not a free of the block
+    memoryManager.free(testArray2 - 1);
+    memoryManager.free(reinterpret_cast<char*>(testArray2) + 3);
+    stats = memoryManager.getStats();
+    std::cout << "Expected: 3 invalid, InvalidFree reported" << std::endl;
+    std::cout << "Got: " << stats.invalidFrees << " invalid, "
+              << (reported.back() == Violation::InvalidFree ? "InvalidFree" : "other") << " reported" << std::endl;
+    if(stats.invalidFrees == 3 && reported.size() == 5 && reported[3] == Violation::InvalidFree &&
+       reported[4] == Violation::InvalidFree) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+    score += testGetList(memoryManager, correctList.size() / 2, correctList);
+
+    // a second deferred free before the drain is a double free too
+    memoryManager.setDeferredFree(true);
+    memoryManager.free(testArray2);
+    memoryManager.free(testArray2);
+    memoryManager.setDeferredFree(false);
+    stats = memoryManager.getStats();
+    std::cout << "Expected: 2 double, DoubleFree reported, 0 used" << std::endl;
+    std::cout << "Got: " << stats.doubleFrees << " double, "
+              << (reported.back() == Violation::DoubleFree ? "DoubleFree" : "other") << " reported, "
+              << stats.usedWords << " used" << std::endl;
+    if(stats.doubleFrees == 2 && reported.size() == 6 && reported.back() == Violation::DoubleFree && stats.usedWords == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
+unsigned int testHeapProfile()
+{
+    std::cout << "Test Case: heap profile" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 64;
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initialize(numberOfWords);
+
+    // a 1 byte period samples every allocation of this size
+    memoryManager.startProfiling(1);
+    void* testArray1 = memoryManager.allocate(64);
+    memoryManager.allocate(128);
+    memoryManager.allocate(64);
+    memoryManager.free(testArray1);
+
+    unsigned int score = 0;
+
+    std::vector<HeapSample> samples = memoryManager.getHeapSamples();
+    // each stack starts at its own call site above
+    std::cout << "Expected: 2 samples, 128 bytes at 8, 64 bytes at 24, distinct callers" << std::endl;
+    std::cout << "Got: " << samples.size() << " samples";
+    for(const HeapSample& sample : samples) {
+        std::cout << ", " << sample.sizeInBytes << " bytes at " << sample.offset;
+    }
+    bool distinct = samples.size() == 2 && !samples[0].stack.empty() && !samples[1].stack.empty() &&
+                    samples[0].stack[0] != samples[1].stack[0];
+    std::cout << ", " << (distinct ? "distinct" : "same") << " callers" << std::endl;
+    if(samples.size() == 2 && samples[0].sizeInBytes == 128 && samples[0].offset == 8 && distinct &&
+       samples[1].sizeInBytes == 64 && samples[1].offset == 24) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    std::string path = "/tmp/MemoryManagerTest-" + std::to_string(getpid()) + ".heap";
+    memoryManager.dumpHeapProfile(path.c_str());
+    std::ifstream profile(path);
+    std::string header;
+    std::getline(profile, header);
+    std::stringstream rest;
+    rest << profile.rdbuf();
+    std::remove(path.c_str());
+    std::cout << "Expected: heap profile: 2: 192 [2: 192] @ heap_v2/1" << std::endl;
+    std::cout << "Got: " << header << std::endl;
+    if(header == "heap profile: 2: 192 [2: 192] @ heap_v2/1" && rest.str().find("MAPPED_LIBRARIES:") != std::string::npos) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.stopProfiling();
+    memoryManager.shutdown();
+
+    return score;
+}
+
+unsigned int testZeroedAllocation()
+{
+    std::cout << "Test Case: zeroed allocation" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 64;
+    MemoryManager memoryManager(wordSize, firstFit);
+    InitOptions options;
+    options.prefault = true;
+    options.zeroThreads = 2;
+    memoryManager.initialize(numberOfWords, options);
+
+    unsigned int score = 0;
+
+    // fresh words are skipped, the freed and scribbled ones are cleared
+    uint8_t* testArray1 = static_cast<uint8_t*>(memoryManager.allocateZeroed(64));
+    std::memset(testArray1, 0xAB, 64);
+    memoryManager.free(testArray1);
+    uint8_t* testArray2 = static_cast<uint8_t*>(memoryManager.allocateZeroed(128));
+    bool zeroed = testArray2 == testArray1;
+    for(size_t i = 0; i < 128; ++i) {
+        zeroed = zeroed && testArray2[i] == 0;
+    }
+    size_t skipped = memoryManager.getStats().zeroFillSkippedWords;
+    std::cout << "Expected: zeroed, 16 words skipped" << std::endl;
+    std::cout << "Got: " << (zeroed ? "zeroed" : "not zeroed") << ", " << skipped << " words skipped" << std::endl;
+    if(zeroed && skipped == 16) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // new[] memory is never known to be zero
+    memoryManager.initialize(numberOfWords);
+    uint8_t* testArray3 = static_cast<uint8_t*>(memoryManager.allocate(64));
+    std::memset(testArray3, 0xAB, 64);
+    uint8_t* testArray4 = static_cast<uint8_t*>(memoryManager.allocateZeroed(64));
+    zeroed = testArray4 != nullptr;
+    for(size_t i = 0; zeroed && i < 64; ++i) {
+        zeroed = testArray4[i] == 0;
+    }
+    skipped = memoryManager.getStats().zeroFillSkippedWords;
+    std::cout << "Expected: zeroed, 0 words skipped" << std::endl;
+    std::cout << "Got: " << (zeroed ? "zeroed" : "not zeroed") << ", " << skipped << " words skipped" << std::endl;
+    if(zeroed && skipped == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // a one word arena with more threads than bytes is zeroed by one of them
+    options.zeroThreads = 16;
+    memoryManager.initialize(1, options);
+    uint64_t* testArray5 = static_cast<uint64_t*>(memoryManager.allocateZeroed(8));
+    std::cout << "Expected: 0" << std::endl;
+    std::cout << "Got: " << (testArray5 != nullptr ? std::to_string(*testArray5) : "nullptr") << std::endl;
+    if(testArray5 != nullptr && *testArray5 == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+unsigned int testMemoryResource()
+{
+    std::cout << "Test Case: memory resource" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 1024;
+    MemoryManager memoryManager(wordSize, firstFit);
+    InitOptions options;
+    options.prefault = true; // page-aligned, so word 8 is the first 64 byte boundary
+    memoryManager.initialize(numberOfWords, options);
+
+    unsigned int score = 0;
+
+    void* testArray1 = memoryManager.allocate(8);
+    void* testArray2 = memoryManager.allocateAligned(24, 64);
+    size_t offset = (static_cast<char*>(testArray2) - static_cast<char*>(memoryManager.getMemoryStart())) / wordSize;
+    uint16_t* list = static_cast<uint16_t*>(memoryManager.getList());
+    std::vector<uint16_t> correctList = {1, 7, 11, 1013};
+    std::vector<uint16_t> gotList(list + 1, list + 1 + 2 * list[0]);
+    delete[] list;
+    std::cout << "Expected: block at word 8, holes " << vectorToString(correctList) << std::endl;
+    std::cout << "Got: block at word " << offset << ", holes " << vectorToString(gotList) << std::endl;
+    if(offset == 8 && gotList == correctList) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray2);
+
+    // containers keep their storage in the arena and hand all of it back
+    bool inArena = true;
+    {
+        MemoryManagerResource resource(memoryManager);
+        std::pmr::vector<uint64_t> testVector(&resource);
+        std::vector<int, ArenaAllocator<int>> testVector2{ArenaAllocator<int>(memoryManager)};
+        for(uint64_t i = 0; i < 100; ++i) {
+            testVector.push_back(i);
+            testVector2.push_back(i);
+        }
+        char* start = static_cast<char*>(memoryManager.getMemoryStart());
+        char* end = start + memoryManager.getMemoryLimit();
+        inArena = reinterpret_cast<char*>(testVector.data()) >= start && reinterpret_cast<char*>(testVector.data()) < end &&
+                  reinterpret_cast<char*>(testVector2.data()) >= start && reinterpret_cast<char*>(testVector2.data()) < end;
+    }
+    size_t usedWords = memoryManager.getStats().usedWords;
+    std::cout << "Expected: in arena, 0 words used after" << std::endl;
+    std::cout << "Got: " << (inArena ? "in arena" : "not in arena") << ", " << usedWords << " words used after" << std::endl;
+    if(inArena && usedWords == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+unsigned int testAsyncAllocation()
+{
+    std::cout << "Test Case: async allocation" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 16;
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initialize(numberOfWords);
+    char* start = static_cast<char*>(memoryManager.getMemoryStart());
+
+    unsigned int score = 0;
+
+    // the smaller class is served first; a waiter that does not fit holds back the rest
+    void* testArray1 = memoryManager.allocate(64);
+    void* testArray2 = memoryManager.allocate(64);
+    std::vector<int> served;
+    std::vector<void*> blocks(4, reinterpret_cast<void*>(-1));
+    memoryManager.allocateAsync(64, [&](void* block) { served.push_back(1); blocks[1] = block; });
+    memoryManager.allocateAsync(32, [&](void* block) { served.push_back(2); blocks[2] = block; });
+    memoryManager.allocateAsync(64, [&](void* block) { served.push_back(3); blocks[3] = block; });
+    memoryManager.free(testArray1);
+    memoryManager.free(testArray2);
+    size_t waiting = memoryManager.getStats().waitingAllocations;
+    std::cout << "Expected: served 2 at 0, then 1 at 32, 1 waiting" << std::endl;
+    std::cout << "Got: served";
+    for(int waiter : served) {
+        std::cout << " " << waiter << " at " << static_cast<char*>(blocks[waiter]) - start;
+    }
+    std::cout << ", " << waiting << " waiting" << std::endl;
+    if(served == std::vector<int>{2, 1} && blocks[2] == start && blocks[1] == start + 32 && waiting == 1) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // shutdown fails the waiter that is left
+    memoryManager.shutdown();
+    std::cout << "Expected: 3 failed on shutdown" << std::endl;
+    std::cout << "Got: " << (served.size() == 3 && blocks[3] == nullptr ? "3 failed" : "3 not failed") << " on shutdown" << std::endl;
+    if(served.size() == 3 && blocks[3] == nullptr) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // a buddy arena of 1000 words places at most 512: a larger request fails
+    // at once and does not hold back the ones behind it
+    memoryManager.initialize(1000, AllocationMode::Buddy);
+    void* testArray3 = reinterpret_cast<void*>(-1);
+    void* testArray4 = nullptr;
+    memoryManager.allocateAsync(600 * 8, [&](void* block) { testArray3 = block; });
+    memoryManager.allocateAsync(8, [&](void* block) { testArray4 = block; });
+    std::cout << "Expected: 600 words failed, 1 word served, 0 waiting" << std::endl;
+    std::cout << "Got: 600 words " << (testArray3 == nullptr ? "failed" : "not failed") << ", 1 word "
+              << (testArray4 != nullptr ? "served" : "not served") << ", " << memoryManager.getStats().waitingAllocations
+              << " waiting" << std::endl;
+    if(testArray3 == nullptr && testArray4 != nullptr && memoryManager.getStats().waitingAllocations == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // with deferred free, the free that makes room still serves the waiter
+    memoryManager.initialize(numberOfWords);
+    memoryManager.setDeferredFree(true);
+    void* testArray5 = memoryManager.allocate(numberOfWords * wordSize);
+    void* testArray6 = nullptr;
+    memoryManager.allocateAsync(64, [&](void* block) { testArray6 = block; });
+    memoryManager.free(testArray5);
+    std::cout << "Expected: served at 0, 0 waiting" << std::endl;
+    std::cout << "Got: " << (testArray6 != nullptr ? "served" : "not served") << " at "
+              << (testArray6 != nullptr ? static_cast<char*>(testArray6) - static_cast<char*>(memoryManager.getMemoryStart()) : -1)
+              << ", " << memoryManager.getStats().waitingAllocations << " waiting" << std::endl;
+    if(testArray6 == memoryManager.getMemoryStart() && memoryManager.getStats().waitingAllocations == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+    memoryManager.setDeferredFree(false);
+
+    // stress: four threads ask for far more than the arena holds and free
+    // what they are handed; every request is served once, in a block no one
+    // else holds
+    memoryManager.initialize(128);
+    const size_t requestsPerThread = 2000;
+    std::mutex readyMutex;
+    std::vector<std::pair<uint64_t*, uint64_t>> ready;
+    std::atomic<size_t> completed(0);
+    std::atomic<size_t> failures(0);
+    auto freeOne = [&]() {
+        std::pair<uint64_t*, uint64_t> block(nullptr, 0);
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            if(ready.empty()) {
+                return false;
+            }
+            block = ready.back();
+            ready.pop_back();
+        }
+        if(*block.first != block.second) {
+            ++failures;
+        }
+        memoryManager.free(block.first);
+        return true;
+    };
+    std::vector<std::thread> threads;
+    for(uint64_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for(uint64_t i = 0; i < requestsPerThread; ++i) {
+                uint64_t id = t * requestsPerThread + i + 1;
+                memoryManager.allocateAsync(8 * (1 + (id * 7) % 32), [&, id](void* block) {
+                    if(block == nullptr) {
+                        ++failures;
+                        ++completed;
+                        return;
+                    }
+                    *static_cast<uint64_t*>(block) = id;
+                    {
+                        std::lock_guard<std::mutex> lock(readyMutex);
+                        ready.emplace_back(static_cast<uint64_t*>(block), id);
+                    }
+                    ++completed;
+                });
+                if(i % 3 != 0) { // hold on to some so the arena fills up and requests queue
+                    freeOne();
+                }
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while((completed < 4 * requestsPerThread || freeOne()) && std::chrono::steady_clock::now() < deadline) {
+        freeOne();
+    }
+    MemoryStats stats = memoryManager.getStats();
+    std::cout << "Expected: " << 4 * requestsPerThread << " served, 0 failures, 0 used, 0 waiting" << std::endl;
+    std::cout << "Got: " << completed << " served, " << failures << " failures, " << stats.usedWords << " used, "
+              << stats.waitingAllocations << " waiting" << std::endl;
+    if(completed == 4 * requestsPerThread && failures == 0 && stats.usedWords == 0 && stats.waitingAllocations == 0) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+unsigned int testMemoryPressure()
+{
+    std::cout << "Test Case: memory pressure" << std::endl;
+    unsigned int wordSize = 8;
+    size_t numberOfWords = 32;
+    MemoryManager memoryManager(wordSize, firstFit);
+    memoryManager.initialize(numberOfWords);
+
+    unsigned int score = 0;
+
+    // a cache of 8 word entries that evicts its oldest when asked to reclaim
+    std::vector<void*> cache;
+    std::vector<std::string> levels;
+    const char* names[] = {"normal", "low", "high"};
+    memoryManager.setWatermarks(16, 24);
+    memoryManager.addPressureCallback([&](Pressure pressure, size_t usedWords) {
+        levels.push_back(std::string(names[static_cast<int>(pressure)]) + "@" + std::to_string(usedWords));
+    });
+    memoryManager.addReclaimHook([&](size_t wordsNeeded) {
+        size_t freed = 0;
+        while(freed < wordsNeeded && !cache.empty()) {
+            memoryManager.free(cache.front());
+            cache.erase(cache.begin());
+            freed += 8;
+        }
+        return freed;
+    });
+
+    for(int i = 0; i < 5; ++i) {
+        cache.push_back(memoryManager.allocate(64)); // the fifth only fits once the first is evicted
+    }
+    MemoryStats stats = memoryManager.getStats();
+    std::string got;
+    for(const std::string& level : levels) {
+        got += level + " ";
+    }
+    std::cout << "Expected: low@16 high@24 , 4 cached, 1 reclaimed, 0 failed" << std::endl;
+    std::cout << "Got: " << got << ", " << cache.size() << " cached, " << stats.reclaimedAllocations << " reclaimed, "
+              << stats.failedAllocations << " failed" << std::endl;
+    if(got == "low@16 high@24 " && cache.size() == 4 && cache.back() != nullptr && stats.reclaimPasses == 1 &&
+       stats.reclaimedAllocations == 1 && stats.failedAllocations == 0 && stats.pressure == Pressure::High) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    // draining the cache steps back down through both watermarks
+    levels.clear();
+    for(void* entry : cache) {
+        memoryManager.free(entry);
+    }
+    cache.clear();
+    stats = memoryManager.getStats();
+    got.clear();
+    for(const std::string& level : levels) {
+        got += level + " ";
+    }
+    std::cout << "Expected: low@16 normal@8 , normal" << std::endl;
+    std::cout << "Got: " << got << ", " << names[static_cast<int>(stats.pressure)] << std::endl;
+    if(got == "low@16 normal@8 " && stats.pressure == Pressure::Normal) {
+        std::cout << "[CORRECT]\n" << std::endl;
+        ++score;
+    }
+    else {
+        std::cout << "[INCORRECT]\n" << std::endl;
+    }
+
+    memoryManager.shutdown();
+
+    return score;
+}
+
+
 std::string vectorToString(const std::vector<uint16_t>& vector)
 {
     std::string vectorString = "";
@@ -2,178 +2,2255 @@
 #include <iostream>
 #include <fstream>
 #include <climits> // new: included to access INT_MAX for bestFit function
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+#include <cerrno>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Start of a shared arena segment. The status bytes follow the header and
+// the data starts at dataOffset; everything is addressed by offset so each
+// process can map the segment wherever it likes.
+struct SharedArenaHeader {
+    std::atomic<uint64_t> magic; // written last by the creator
+    uint32_t version;
+    uint32_t wordSize;
+    uint64_t words;
+    uint64_t dataOffset;
+    std::atomic<uint64_t> generation; // bumped whenever the status bytes change
+    pthread_mutex_t lock; // robust and process-shared
+    uint64_t journalOffset; // status bytes being rewritten while journalActive is set
+    uint64_t journalWords;
+    std::atomic<uint32_t> journalActive;
+};
+
+// Holds the manager's mutex and, for a shared arena, the segment lock
+class MemoryManager::ArenaLock {
+public:
+    explicit ArenaLock(MemoryManager& manager) : manager(manager), lock(manager.mutex) {
+        manager.lockShared();
+    }
+    ~ArenaLock() {
+        manager.unlockShared();
+    }
+
+private:
+    MemoryManager& manager;
+    std::lock_guard<std::mutex> lock;
+};
+
+int bestFit(int sizeInWords, void* list);
+int worstFit(int sizeInWords, void* list);
+int firstFit(int sizeInWords, void* list);
+
+namespace {
+
+// allocationStatus flags
+const uint8_t kAllocated = 0x01; // word belongs to a block
+const uint8_t kBlockStart = 0x02; // word is the first word of a block
+const uint8_t kGuarded = 0x04; // hardened block: its handle, or with kBlockStart the first front guard word
+const uint8_t kOrderShift = 3; // buddy order of the block, on its first word
+
+// deferredNext values that are not offsets
+const uint32_t kDeferredIdle = UINT32_MAX; // word is not queued
+const uint32_t kDeferredEnd = UINT32_MAX - 1; // end of the deferred list
+
+const uint8_t kCanaryByte = 0xFD; // fills guard words
+const uint8_t kPoisonByte = 0xDD; // fills freed hardened blocks
+
+const size_t kChangeChunkWords = 512; // granularity of change tracking
+
+const uint64_t kSharedMagic = 0x4d4d4152454e4131ULL; // "MMARENA1"
+const uint32_t kSharedVersion = 2;
+
+// Smallest order whose block holds `words`
+uint8_t orderFor(size_t words) {
+    uint8_t order = 0;
+    while ((size_t(1) << order) < words) {
+        ++order;
+    }
+    return order;
+}
+
+// An online NUMA node and the CPUs attached to it
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+// Parses a sysfs list such as "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int low = std::stoi(range.substr(0, dash));
+            int high = dash == std::string::npos ? low : std::stoi(range.substr(dash + 1));
+            for (int value = low; value <= high; ++value) {
+                values.push_back(value);
+            }
+        }
+        catch (const std::exception&) {
+            continue; // blank or malformed entry
+        }
+    }
+    return values;
+}
+
+// Reads the online nodes from sysfs. Anything missing, as on a kernel
+// without NUMA support, leaves a single node owning every CPU.
+std::vector<NumaNode> detectNumaNodes() {
+    std::vector<NumaNode> nodes;
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (online && std::getline(online, list)) {
+        for (int id : parseCpuList(list)) {
+            std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string cpus;
+            if (cpulist && std::getline(cpulist, cpus)) {
+                nodes.push_back(NumaNode{id, parseCpuList(cpus)});
+            }
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, std::vector<int>()});
+    }
+    return nodes;
+}
+
+// mbind(MPOL_BIND) through the raw syscall so no libnuma is needed; a
+// failure just leaves the pages to first touch
+void bindToNode(char* start, size_t length, int node) {
+    const int kMpolBind = 2;
+    if (length == 0 || node < 0 || node >= 64) {
+        return;
+    }
+    unsigned long mask = 1UL << node;
+    syscall(SYS_mbind, start, length, kMpolBind, &mask, sizeof(mask) * 8, 0);
+}
+
+// Zeroes [start, start + bytes) in page-aligned slices, one per thread, so
+// the page faults of first touch are taken in parallel. A slice is at least a
+// page, so small arenas use fewer threads.
+void zeroParallel(char* start, size_t bytes, unsigned threads) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t slice = std::max(page, (bytes / threads + page - 1) / page * page);
+    std::vector<std::thread> workers;
+    for (size_t first = slice; first < bytes; first += slice) {
+        workers.emplace_back([=]() { std::memset(start + first, 0, std::min(slice, bytes - first)); });
+    }
+    std::memset(start, 0, std::min(slice, bytes));
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Sets count bits starting at first
+void setBits(std::vector<uint64_t>& bits, size_t first, size_t count) {
+    for (size_t i = first; i < first + count;) {
+        size_t span = std::min<size_t>(64 - i % 64, first + count - i);
+        bits[i / 64] |= (span == 64 ? ~uint64_t(0) : ((uint64_t(1) << span) - 1)) << (i % 64);
+        i += span;
+    }
+}
+
+// Clears count bits starting at first
+void clearBits(std::vector<uint64_t>& bits, size_t first, size_t count) {
+    for (size_t i = first; i < first + count;) {
+        size_t span = std::min<size_t>(64 - i % 64, first + count - i);
+        bits[i / 64] &= ~((span == 64 ? ~uint64_t(0) : ((uint64_t(1) << span) - 1)) << (i % 64));
+        i += span;
+    }
+}
+
+// Size of a segment holding sizeInWords words; the data starts at dataOffset
+size_t segmentBytes(size_t sizeInWords, unsigned wordSize, size_t& dataOffset) {
+    dataOffset = (sizeof(SharedArenaHeader) + sizeInWords + 63) / 64 * 64;
+    return dataOffset + sizeInWords * wordSize;
+}
+
+// Makes the segment lock robust and process-shared
+void initSegmentLock(SharedArenaHeader* header) {
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+// Writes the header of a zero-filled segment. The magic goes last so an
+// attaching process never sees a half-built header.
+void formatSegment(void* mapping, unsigned wordSize, size_t sizeInWords, size_t dataOffset) {
+    SharedArenaHeader* header = new (mapping) SharedArenaHeader();
+    header->version = kSharedVersion;
+    header->wordSize = wordSize;
+    header->words = sizeInWords;
+    header->dataOffset = dataOffset;
+    header->generation.store(0);
+    header->journalActive.store(0);
+    initSegmentLock(header);
+    header->magic.store(kSharedMagic, std::memory_order_release);
+}
+
+// True if the mapping holds a complete arena made for this word size
+bool validSegment(const SharedArenaHeader* header, size_t bytes, unsigned wordSize) {
+    if (header->magic.load(std::memory_order_acquire) != kSharedMagic || header->version != kSharedVersion ||
+        header->wordSize != wordSize || header->words > 65536) {
+        return false;
+    }
+    return header->dataOffset >= sizeof(SharedArenaHeader) + header->words &&
+           header->dataOffset + header->words * wordSize <= bytes;
+}
+
+// Undoes a status update that was cut short. Clearing the range is right
+// either way: an allocation that never finished was never handed out, and a
+// free that never finished was already asked for.
+void recoverJournal(SharedArenaHeader* header) {
+    if (header->journalActive.load(std::memory_order_acquire)) {
+        uint8_t* status = reinterpret_cast<uint8_t*>(header + 1);
+        size_t offset = std::min<uint64_t>(header->journalOffset, header->words);
+        size_t words = std::min<uint64_t>(header->journalWords, header->words - offset);
+        std::fill(status + offset, status + offset + words, 0);
+        header->journalActive.store(0, std::memory_order_release);
+    }
+    header->generation.fetch_add(1); // every process reloads
+}
+
+// Maps the stock callbacks onto their typed policies; anything else goes
+// through the hole list adapter
+std::unique_ptr<PlacementPolicy> policyFor(std::function<int(int, void*)> allocator) {
+    auto* function = allocator.target<int (*)(int, void*)>();
+    if (function && *function == bestFit) {
+        return std::unique_ptr<PlacementPolicy>(new BestFitPolicy());
+    }
+    if (function && *function == worstFit) {
+        return std::unique_ptr<PlacementPolicy>(new WorstFitPolicy());
+    }
+    if (function && *function == firstFit) {
+        return std::unique_ptr<PlacementPolicy>(new FirstFitPolicy());
+    }
+    return std::unique_ptr<PlacementPolicy>(new CallbackPolicy(allocator));
+}
+
+} // namespace
 
 // Constructor initializing word size and allocator function
 MemoryManager::MemoryManager(unsigned wordSize, std::function<int(int, void*)> allocator)
-    : wordSize(wordSize), allocator(allocator), memoryStart(nullptr), memoryLimit(0) {
+    : MemoryManager(wordSize, policyFor(allocator)) {
+}
+
+// Constructor initializing word size and a typed placement policy
+MemoryManager::MemoryManager(unsigned wordSize, std::unique_ptr<PlacementPolicy> policy)
+    : wordSize(wordSize), memoryLimit(0), memoryStart(nullptr), policy(std::move(policy)),
+      mode(AllocationMode::Placement), usedWords(0), requestedWords(0), allocationCount(0),
+      failedAllocationCount(0), freeCount(0), deferredFree(false), deferredHead(kDeferredEnd),
+      deferredPending(0), maintenanceStop(false), asyncWaiting(0), smallClassSlotWords(0), smallClassOffset(0),
+      smallClassSlotCount(0), smallClassBitmapWords(0), arenaMapped(false), partitionWords(1),
+      sharedHeader(nullptr), sharedStatus(nullptr), sharedBytes(0), sharedOwner(false), sharedFileFd(-1),
+      sharedGeneration(0),
+      sharedDirty(false), hardeningSequence(0), hardenedAllocationCount(0), guardViolationCount(0),
+      doubleFreeCount(0), invalidFreeCount(0), zeroFillSkippedCount(0), lowWatermark(0),
+      highWatermark(0), pressure(Pressure::Normal), nextHookId(1), reclaimPassCount(0), reclaimedAllocationCount(0),
+      profileSampleBytes(0), profileCountdown(0),
+      changeTracking(false), changeEpoch(0), changeStampers(0), chunkCount(0) {
+}
+
+// Destructor to shut down memory manager when object is destroyed
+MemoryManager::~MemoryManager() {
+    stopMaintenanceThread();
+    shutdown();
+}
+
+// Initializes memory with a specified number of words
+void MemoryManager::initialize(size_t sizeInWords, AllocationMode mode) {
+    InitOptions options;
+    options.mode = mode;
+    initialize(sizeInWords, options);
+}
+
+// Initializes memory, optionally split into one partition per NUMA node or
+// placed in a named shared-memory segment. Prefaulting and zeroing move the
+// page faults of first touch out of the allocation path; a private arena
+// that is known to be zero lets allocateZeroed() skip clearing fresh words.
+void MemoryManager::initialize(size_t sizeInWords, const InitOptions& options) {
+    if (sizeInWords > 65536) { // new: checks the maximum word limit
+        std::cout << "Initialization failed: Exceeds maximum word limit of 65536." << std::endl;
+        return;
+    }
+    if (options.sharedName != nullptr && options.mode != AllocationMode::Placement) {
+        std::cout << "Initialization failed: Shared arenas use placement mode." << std::endl;
+        return;
+    }
+
+    cancelWaiters();
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseArena();
+
+    // Partitions only make sense for placement; buddy blocks span the arena
+    std::vector<NumaNode> numaNodes = detectNumaNodes();
+    size_t partitions = 1;
+    if (options.numa && options.mode == AllocationMode::Placement && options.sharedName == nullptr) {
+        partitions = options.numaNodes ? options.numaNodes : numaNodes.size();
+        partitions = std::max<size_t>(1, std::min(partitions, sizeInWords));
+    }
+    partitionWords = sizeInWords ? (sizeInWords + partitions - 1) / partitions : 1;
+    cpuNode.clear();
+    for (size_t node = 0; node < numaNodes.size(); ++node) {
+        for (int cpu : numaNodes[node].cpus) {
+            if (cpuNode.size() <= static_cast<size_t>(cpu)) {
+                cpuNode.resize(cpu + 1, 0);
+            }
+            cpuNode[cpu] = node;
+        }
+    }
+
+    if (options.sharedName != nullptr) {
+        if (!createShared(options.sharedName, sizeInWords)) {
+            std::cout << "Initialization failed: Cannot create shared arena " << options.sharedName << "." << std::endl;
+            return;
+        }
+    }
+    else if (partitions > 1 || options.prefault || options.zeroThreads > 0) {
+        // NUMA partitions need page-aligned memory to be bound; fresh anonymous pages are zero
+        memoryLimit = sizeInWords * wordSize;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | (options.prefault && partitions == 1 ? MAP_POPULATE : 0);
+        void* mapping = mmap(nullptr, memoryLimit, PROT_READ | PROT_WRITE, flags, -1, 0);
+        arenaMapped = mapping != MAP_FAILED;
+        memoryStart = arenaMapped ? static_cast<char*>(mapping) : new char[memoryLimit];
+    }
+    else {
+        memoryLimit = sizeInWords * wordSize;
+        memoryStart = new char[memoryLimit];
+    }
+
+    this->mode = options.mode;
+    resetMetadata(sizeInWords);
+    if (nodeStats.size() > 1) {
+        bindPartitions(); // before any touch, so pages fault in on their own node
+    }
+    if (options.prefault) {
+        if (sharedHeader != nullptr) {
+            madvise(sharedHeader, sharedBytes, MADV_WILLNEED);
+        }
+        else if (arenaMapped) {
+            madvise(memoryStart, memoryLimit, MADV_WILLNEED);
+        }
+    }
+    if (options.zeroThreads > 0) {
+        zeroParallel(memoryStart, memoryLimit, options.zeroThreads);
+    }
+    if (sharedHeader == nullptr && (arenaMapped || options.zeroThreads > 0)) {
+        std::fill(dirtyBits.begin(), dirtyBits.end(), 0);
+    }
+}
+
+// Maps the arena of an existing shared segment. The hole index is rebuilt
+// from the segment's status bytes, so blocks other processes hold stay taken.
+bool MemoryManager::attach(const char* sharedName) {
+    cancelWaiters();
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseArena();
+
+    int fd = shm_open(sharedName, O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(SharedArenaHeader)) {
+        mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    if (!validSegment(static_cast<SharedArenaHeader*>(mapping), info.st_size, wordSize)) {
+        munmap(mapping, info.st_size); // not an arena, not finished, or made for another word size
+        return false;
+    }
+
+    adoptSegment(mapping, info.st_size);
+    this->sharedName = sharedName;
+    resetMetadata(memoryLimit / wordSize);
+    return true;
+}
+
+// Maps a file as the arena, creating it if it is empty. A file that already
+// holds an arena is reopened as it was: the header is checked and any status
+// update cut short by a crash is undone, which is all the startup work; the
+// arena pages fault in as they are used and the hole index is rebuilt from
+// the status bytes on the first call that needs it. The file is locked for
+// as long as it is mapped; one that is already open elsewhere is refused.
+bool MemoryManager::initializeFromFile(const char* path, size_t sizeInWords) {
+    if (sizeInWords > 65536) {
+        return false;
+    }
+
+    cancelWaiters();
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseArena();
+
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t dataOffset;
+    size_t bytes = segmentBytes(sizeInWords, wordSize, dataOffset);
+    struct stat info = {};
+    bool fresh = fstat(fd, &info) == 0 && info.st_size == 0;
+    void* mapping = MAP_FAILED;
+    if (fresh ? ftruncate(fd, bytes) == 0 : static_cast<size_t>(info.st_size) == bytes) {
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    SharedArenaHeader* header = static_cast<SharedArenaHeader*>(mapping);
+    if (fresh) {
+        formatSegment(mapping, wordSize, sizeInWords, dataOffset);
+    }
+    else if (!validSegment(header, bytes, wordSize) || header->words != sizeInWords) {
+        munmap(mapping, bytes);
+        close(fd);
+        return false;
+    }
+    else {
+        initSegmentLock(header); // whoever held it is gone; the file lock keeps everyone else out
+        recoverJournal(header);
+    }
+
+    adoptSegment(mapping, bytes);
+    sharedFileFd = fd;
+    resetMetadata(sizeInWords);
+    return true;
+}
+
+// Shuts down the memory manager and releases resources
+void MemoryManager::shutdown() {
+    cancelWaiters();
+    std::lock_guard<std::mutex> lock(mutex);
+    releaseArena();
+    allocationStatus.clear();
+    allocatedBits.clear();
+    blockStartBits.clear();
+    dirtyBits.clear();
+    holes.clear();
+    buddyFreeLists.clear();
+    buddyRequested.clear();
+    nodeStats.clear();
+    usedWords = 0;
+    requestedWords = 0;
+    pressure = Pressure::Normal;
+    deferredNext.reset();
+    deferredHead.store(kDeferredEnd);
+    deferredPending.store(0);
+    smallClassSlotWords.store(0);
+    smallClassBits.reset();
+}
+
+// Starts every word free, one hole per partition, with empty queues and counters
+void MemoryManager::resetMetadata(size_t sizeInWords) {
+    allocationStatus.assign(sizeInWords, 0); // all words start free
+    allocatedBits.assign((sizeInWords + 63) / 64, 0);
+    blockStartBits.assign((sizeInWords + 63) / 64, 0);
+    dirtyBits.assign((sizeInWords + 63) / 64, ~uint64_t(0)); // initialize() clears it when the arena is known zero
+    holes.clear();
+    nodeStats.clear();
+    for (size_t start = 0; start < sizeInWords; start += partitionWords) {
+        size_t length = std::min(partitionWords, sizeInWords - start);
+        holes[start] = length;
+        nodeStats.push_back(NodeStats{length, 0, 0, 0});
+    }
+
+    usedWords = 0;
+    requestedWords = 0;
+    allocationCount = 0;
+    failedAllocationCount = 0;
+    freeCount = 0;
+    hardeningSequence = 0;
+    hardenedAllocationCount = 0;
+    zeroFillSkippedCount = 0;
+    reclaimPassCount = 0;
+    reclaimedAllocationCount = 0;
+    pressure = Pressure::Normal; // a fresh arena starts empty, without a callback
+    guardViolationCount = 0;
+    doubleFreeCount = 0;
+    invalidFreeCount = 0;
+    heapSamples.clear();
+    buddyRequested.clear();
+    buddyFreeLists.assign(orderFor(sizeInWords) + 1, std::set<size_t>());
+
+    // An arena that is not a power of two starts as one free block per set
+    // bit of its size, largest first, so every block is aligned to its size
+    if (mode == AllocationMode::Buddy) {
+        size_t offset = 0;
+        for (int order = static_cast<int>(buddyFreeLists.size()) - 1; order >= 0; --order) {
+            if (sizeInWords & (size_t(1) << order)) {
+                buddyFreeLists[order].insert(offset);
+                offset += size_t(1) << order;
+            }
+        }
+    }
+
+    deferredNext.reset(new std::atomic<uint32_t>[sizeInWords]);
+    for (size_t i = 0; i < sizeInWords; ++i) {
+        deferredNext[i].store(kDeferredIdle, std::memory_order_relaxed);
+    }
+    deferredHead.store(kDeferredEnd);
+    deferredPending.store(0);
+    smallClassSlotWords.store(0);
+    smallClassBits.reset();
+    if (changeTracking.load()) {
+        resetChangeTracking(sizeInWords);
+    }
+}
+
+// Allocates a block and returns its address
+void* MemoryManager::allocate(size_t sizeInBytes) {
+    int offset = allocateBlock(sizeInBytes, 0, __builtin_return_address(0));
+    return offset < 0 ? nullptr : memoryStart + (offset * wordSize);
+}
+
+// Allocates a block and clears it. Words that have not been freed since the
+// arena was zeroed are still zero and are left alone, so a block carved from
+// fresh pages costs no memset and does not touch its pages.
+void* MemoryManager::allocateZeroed(size_t sizeInBytes) {
+    int offset = allocateBlock(sizeInBytes, 0, __builtin_return_address(0));
+    if (offset < 0) {
+        return nullptr;
+    }
+    char* block = memoryStart + offset * wordSize;
+
+    // Small class slots are reused without passing through markFree
+    size_t slotWords = smallClassSlotWords.load(std::memory_order_acquire);
+    if (slotWords > 0 && static_cast<size_t>(offset) >= smallClassOffset &&
+        static_cast<size_t>(offset) < smallClassOffset + smallClassSlotCount * slotWords) {
+        std::memset(block, 0, sizeInBytes);
+        return block;
+    }
+
+    ArenaLock lock(*this);
+    size_t words = (sizeInBytes + wordSize - 1) / wordSize;
+    for (size_t i = 0; i < words;) {
+        size_t end = i;
+        while (end < words && (dirtyBits[(offset + end) / 64] >> ((offset + end) % 64) & 1)) {
+            ++end;
+        }
+        if (end == i) {
+            ++zeroFillSkippedCount;
+            ++i;
+            continue;
+        }
+        std::memset(block + i * wordSize, 0, std::min(end * wordSize, sizeInBytes) - i * wordSize);
+        i = end;
+    }
+    return block;
+}
+
+// Allocates a block and returns its word offset, or -1
+int MemoryManager::allocateOffset(size_t sizeInBytes) {
+    return allocateBlock(sizeInBytes, 0, __builtin_return_address(0));
+}
+
+// Allocates a block whose address is a multiple of alignment, a power of two.
+// Word addresses already meet alignments that divide the word size; a
+// stricter one places the block at the first aligned word of a hole with
+// room to spare, leaving the words before it free. Hardened mode does not
+// guard such blocks, and buddy mode does not serve them.
+void* MemoryManager::allocateAligned(size_t sizeInBytes, size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return nullptr;
+    }
+    int offset = allocateBlock(sizeInBytes, alignment, __builtin_return_address(0));
+    return offset < 0 ? nullptr : memoryStart + (offset * wordSize);
+}
+
+// Every word address is a multiple of alignment
+bool MemoryManager::wordAligned(size_t alignment) const {
+    return alignment == 0 || (wordSize % alignment == 0 && reinterpret_cast<uintptr_t>(memoryStart) % alignment == 0);
+}
+
+// Allocates a block at an address that is a multiple of alignment, 0 for any
+// word. caller is the public entry point's return address, where a profiler
+// sample's stack starts.
+int MemoryManager::allocateBlock(size_t sizeInBytes, size_t alignment, const void* caller) {
+    size_t slotWords = smallClassSlotWords.load(std::memory_order_acquire);
+    if (sizeInBytes > 0 && slotWords > 0 && sizeInBytes <= slotWords * wordSize && wordAligned(alignment)) {
+        void* slot = allocateSmall();
+        if (slot != nullptr) {
+            return (static_cast<char*>(slot) - memoryStart) / wordSize;
+        }
+    }
+
+    int offset;
+    bool reclaim;
+    WokenWaiters woken;
+    PressureChange change;
+    {
+        ArenaLock lock(*this);
+        size_t failed = failedAllocationCount;
+        offset = allocateLocked(sizeInBytes, alignment, caller, &woken);
+        reclaim = failedAllocationCount > failed && !reclaimHooks.empty(); // placement failed, not the arguments
+        change = updatePressure();
+    }
+    runWaiters(woken);
+    notifyPressure(change);
+    if (!reclaim) {
+        return offset;
+    }
+
+    // One reclaim pass, then a single retry; the call counts as one failure at most
+    runReclaimHooks((sizeInBytes + wordSize - 1) / wordSize);
+    {
+        ArenaLock lock(*this);
+        size_t failed = failedAllocationCount;
+        offset = allocateLocked(sizeInBytes, alignment, caller, &woken);
+        if (failedAllocationCount > failed || (offset >= 0 && failedAllocationCount > 0)) {
+            --failedAllocationCount;
+        }
+        ++reclaimPassCount;
+        reclaimedAllocationCount += offset >= 0 ? 1 : 0;
+        change = updatePressure();
+    }
+    runWaiters(woken);
+    notifyPressure(change);
+    return offset;
+}
+
+// Places and accounts for a block outside the small class; caller holds the
+// lock. Blocks with no caller to blame are not profiled. Parked requests
+// served from queued frees are added to woken, when given.
+int MemoryManager::allocateLocked(size_t sizeInBytes, size_t alignment, const void* caller, WokenWaiters* woken) {
+    if (memoryStart == nullptr || sizeInBytes == 0 || (!policy && mode == AllocationMode::Placement)) {
+        return -1;
+    }
+
+    // Sampled allocations in hardened mode carry guard words on both sides
+    bool sampled = hardening.enabled && hardening.sampleRate > 0 && hardening.guardWords > 0 &&
+                   hardeningSequence++ % hardening.sampleRate == 0 &&
+                   wordAligned(alignment);
+    size_t guardWords = sampled ? hardening.guardWords : 0;
+
+    size_t wordsNeeded = (sizeInBytes + wordSize - 1) / wordSize + 2 * guardWords;
+    int offset = placeBlock(wordsNeeded, alignment);
+    if (offset < 0 && drainDeferred() > 0) {
+        if (woken != nullptr) {
+            serveWaiters(*woken); // parked requests were in line for the freed space first
+        }
+        offset = placeBlock(wordsNeeded, alignment); // queued frees may have opened a big enough hole
+    }
+
+    if (mode == AllocationMode::Placement) {
+        policy->observe(wordsNeeded, offset >= 0, getHoles());
+    }
+    if (offset < 0) {
+        ++failedAllocationCount;
+        return -1;
+    }
+
+    if (mode == AllocationMode::Buddy) {
+        buddyRequested[offset] = wordsNeeded;
+    }
+    requestedWords += wordsNeeded;
+    ++allocationCount;
+    if (sampled) {
+        armBlock(offset, wordsNeeded, guardWords);
+    }
+    if (profileSampleBytes > 0 && caller != nullptr) {
+        recordSample(offset, sizeInBytes, caller);
+    }
+    return offset + guardWords;
+}
+
+// Frees a previously allocated block
+void MemoryManager::free(void* address) {
+    if (address == nullptr) {
+        return;
+    }
+    if (address < memoryStart || address >= (static_cast<char*>(memoryStart) + memoryLimit)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (hardening.enabled) {
+            reportViolation(Violation::InvalidFree, SIZE_MAX);
+        }
+        return; // does nothing if the address is invalid or out of range
+    }
+
+    size_t byteOffset = static_cast<char*>(address) - static_cast<char*>(memoryStart);
+    if (byteOffset % wordSize != 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (hardening.enabled) {
+            reportViolation(Violation::InvalidFree, byteOffset / wordSize);
+        }
+        return; // inside a word, so not the start of any block
+    }
+
+    freeOffset(byteOffset / wordSize);
+}
+
+// Frees the block starting at a word offset; offsets past the arena are ignored
+void MemoryManager::freeOffset(size_t offset) {
+    if (memoryStart == nullptr || offset >= memoryLimit / wordSize) {
+        return;
+    }
+
+    if (freeSmall(memoryStart + offset * wordSize)) {
+        return;
+    }
+
+    if (deferredFree.load(std::memory_order_relaxed)) {
+        pushDeferred(offset);
+        if (asyncWaiting.load() > 0) {
+            maintain(); // a parked request may fit now, as in eager mode
+        }
+        return;
+    }
+
+    WokenWaiters woken;
+    PressureChange change;
+    {
+        ArenaLock lock(*this);
+        releaseBlock(offset);
+        serveWaiters(woken);
+        change = updatePressure();
+    }
+    runWaiters(woken);
+    notifyPressure(change);
+}
+
+// Allocates now if the block fits and nothing is queued ahead, otherwise parks the request
+void MemoryManager::allocateAsync(size_t sizeInBytes, std::function<void(void*)> callback) {
+    void* block = nullptr;
+    bool parked = false;
+    WokenWaiters woken;
+    PressureChange change;
+    {
+        ArenaLock lock(*this);
+        size_t wordsNeeded = (sizeInBytes + wordSize - 1) / wordSize;
+        bool possible = memoryStart != nullptr && sizeInBytes > 0 && (policy || mode == AllocationMode::Buddy) &&
+                        wordsNeeded + guardOverhead() <= largestPlaceable();
+        if (possible) {
+            // Counted before the queued frees are drained, so a deferred free
+            // that comes after the drain sees a waiter and drains again
+            asyncWaiting.fetch_add(1);
+            serveWaiters(woken);
+
+            // Smaller classes are served first anyway, so a request below every
+            // waiting class overtakes no one by taking the space now
+            uint8_t sizeClass = orderFor(wordsNeeded);
+            bool first = asyncWaiters.empty() || sizeClass < asyncWaiters.begin()->first;
+            int offset = first && fitsNow(wordsNeeded) ? allocateLocked(sizeInBytes, 0, __builtin_return_address(0), &woken)
+                                                       : -1;
+            if (offset >= 0) {
+                block = memoryStart + offset * wordSize;
+                asyncWaiting.fetch_sub(1);
+            }
+            else {
+                asyncWaiters[sizeClass].push_back(AsyncWaiter{sizeInBytes, std::move(callback)});
+                parked = true;
+            }
+        }
+        change = updatePressure();
+    }
+    runWaiters(woken);
+    notifyPressure(change);
+    if (!parked) {
+        callback(block);
+    }
+}
+
+// Hands served async requests their blocks; caller does not hold the lock
+void MemoryManager::runWaiters(WokenWaiters& woken) {
+    for (auto& waiter : woken) {
+        waiter.first(waiter.second);
+    }
+}
+
+// Canary words a sampled block may add on top of the request
+size_t MemoryManager::guardOverhead() const {
+    return hardening.enabled && hardening.sampleRate > 0 ? 2 * hardening.guardWords : 0;
+}
+
+// Words in the biggest block the arena could place once every other block is
+// freed: holes stop at partitions and at the small class region, and a buddy
+// block is a power of two aligned to its size
+size_t MemoryManager::largestPlaceable() const {
+    size_t totalWords = allocationStatus.size();
+    size_t slotWords = smallClassSlotWords.load(std::memory_order_acquire);
+    size_t regionStart = smallClassOffset;
+    size_t regionEnd = slotWords > 0 ? smallClassOffset + slotWords * smallClassSlotCount : smallClassOffset;
+    size_t largest = 0;
+    if (mode == AllocationMode::Buddy) {
+        // Top blocks are the set bits of the size, largest first; the one
+        // holding the region keeps at most its upper half free
+        size_t start = 0;
+        for (int order = static_cast<int>(buddyFreeLists.size()) - 1; order >= 0; --order) {
+            size_t length = size_t(1) << order;
+            if (!(totalWords & length)) {
+                continue;
+            }
+            bool holdsRegion = regionEnd > regionStart && regionStart >= start && regionStart < start + length;
+            size_t free = !holdsRegion ? length : (regionEnd - regionStart <= length / 2 ? length / 2 : 0);
+            largest = std::max(largest, free);
+            start += length;
+        }
+        return largest;
+    }
+    for (size_t start = 0; start < totalWords; start += partitionWords) {
+        size_t end = std::min(start + partitionWords, totalWords);
+        if (regionEnd > regionStart && regionStart >= start && regionStart < end) {
+            largest = std::max({largest, regionStart - start, end - regionEnd});
+        }
+        else {
+            largest = std::max(largest, end - start);
+        }
+    }
+    return largest;
+}
+
+// A placement the arena can make right now, guard words included, so a
+// waiter that does not fit yet is not counted as a failed allocation
+bool MemoryManager::fitsNow(size_t wordsNeeded) const {
+    wordsNeeded += guardOverhead();
+    if (mode == AllocationMode::Buddy) {
+        for (size_t order = orderFor(wordsNeeded); order < buddyFreeLists.size(); ++order) {
+            if (!buddyFreeLists[order].empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return std::any_of(holes.begin(), holes.end(),
+                       [wordsNeeded](const HoleIndex::value_type& hole) { return hole.second >= wordsNeeded; });
+}
+
+// Drains the queued frees, then serves the smallest size class first and
+// stops at the first waiter that does not fit: larger classes would not fit
+// either, and later requests in its own class must not overtake it.
+void MemoryManager::serveWaiters(WokenWaiters& woken) {
+    if (!asyncWaiters.empty()) {
+        drainDeferred();
+    }
+    while (!asyncWaiters.empty()) {
+        auto sizeClass = asyncWaiters.begin();
+        AsyncWaiter& waiter = sizeClass->second.front();
+        size_t wordsNeeded = (waiter.sizeInBytes + wordSize - 1) / wordSize;
+        int offset = fitsNow(wordsNeeded) ? allocateLocked(waiter.sizeInBytes, 0, nullptr, nullptr) : -1; // the freeing thread is not the requester
+        if (offset < 0) {
+            return;
+        }
+        woken.emplace_back(std::move(waiter.callback), memoryStart + offset * wordSize);
+        sizeClass->second.pop_front();
+        asyncWaiting.fetch_sub(1);
+        if (sizeClass->second.empty()) {
+            asyncWaiters.erase(sizeClass);
+        }
+    }
+}
+
+// Sets the soft limits and reports the level they put the arena at
+void MemoryManager::setWatermarks(size_t lowWords, size_t highWords) {
+    PressureChange change;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lowWatermark = lowWords;
+        highWatermark = highWords;
+        change = updatePressure();
+    }
+    notifyPressure(change);
+}
+
+size_t MemoryManager::addPressureCallback(std::function<void(Pressure, size_t)> callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pressureCallbacks.emplace_back(nextHookId, std::move(callback));
+    return nextHookId++;
+}
+
+size_t MemoryManager::addReclaimHook(std::function<size_t(size_t)> hook) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reclaimHooks.emplace_back(nextHookId, std::move(hook));
+    return nextHookId++;
+}
+
+void MemoryManager::removeHook(size_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto matches = [id](const auto& entry) { return entry.first == id; };
+    pressureCallbacks.erase(std::remove_if(pressureCallbacks.begin(), pressureCallbacks.end(), matches),
+                            pressureCallbacks.end());
+    reclaimHooks.erase(std::remove_if(reclaimHooks.begin(), reclaimHooks.end(), matches), reclaimHooks.end());
+}
+
+// Two comparisons per locked allocate or free; the callbacks only run on a change of level
+MemoryManager::PressureChange MemoryManager::updatePressure() {
+    Pressure level = Pressure::Normal;
+    if (highWatermark > 0 && usedWords >= highWatermark) {
+        level = Pressure::High;
+    }
+    else if (lowWatermark > 0 && usedWords >= lowWatermark) {
+        level = Pressure::Low;
+    }
+    PressureChange change{level != pressure, level, usedWords};
+    pressure = level;
+    return change;
+}
+
+// The callbacks are copied under the lock so they can register, remove or free
+void MemoryManager::notifyPressure(const PressureChange& change) {
+    if (!change.changed) {
+        return;
+    }
+    std::vector<std::pair<size_t, std::function<void(Pressure, size_t)>>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callbacks = pressureCallbacks;
+    }
+    for (auto& callback : callbacks) {
+        callback.second(change.pressure, change.usedWords);
+    }
+}
+
+// Runs the hooks in registration order until they report wordsNeeded freed
+void MemoryManager::runReclaimHooks(size_t wordsNeeded) {
+    std::vector<std::pair<size_t, std::function<size_t(size_t)>>> hooks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        hooks = reclaimHooks;
+    }
+    size_t freed = 0;
+    for (auto& hook : hooks) {
+        freed += hook.second(wordsNeeded - freed);
+        if (freed >= wordsNeeded) {
+            break;
+        }
+    }
+}
+
+// Takes the queues out under the lock and fails them once it is released
+void MemoryManager::cancelWaiters() {
+    std::map<uint8_t, std::deque<AsyncWaiter>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled.swap(asyncWaiters);
+        for (const auto& sizeClass : cancelled) {
+            asyncWaiting.fetch_sub(sizeClass.second.size());
+        }
+    }
+    for (auto& sizeClass : cancelled) {
+        for (AsyncWaiter& waiter : sizeClass.second) {
+            waiter.callback(nullptr);
+        }
+    }
+}
+
+// Sets the allocator function to either bestFit or worstFit
+void MemoryManager::setAllocator(std::function<int(int, void*)> allocator) {
+    std::lock_guard<std::mutex> lock(mutex);
+    policy = policyFor(allocator);
+}
+
+// Sets a typed placement policy
+void MemoryManager::setPlacementPolicy(std::unique_ptr<PlacementPolicy> policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->policy = std::move(policy);
+}
+
+// Switches free() between releasing inline and queueing
+void MemoryManager::setDeferredFree(bool enabled) {
+    deferredFree.store(enabled);
+    if (!enabled) {
+        maintain();
+    }
+}
+
+// Releases every queued free
+size_t MemoryManager::maintain() {
+    WokenWaiters woken;
+    size_t released;
+    PressureChange change;
+    {
+        ArenaLock lock(*this);
+        released = drainDeferred();
+        serveWaiters(woken);
+        change = updatePressure();
+    }
+    runWaiters(woken);
+    notifyPressure(change);
+    return released;
+}
+
+// Starts a thread that calls maintain() every interval
+void MemoryManager::startMaintenanceThread(std::chrono::milliseconds interval) {
+    stopMaintenanceThread();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        maintenanceStop = false;
+    }
+    maintenanceThread = std::thread(&MemoryManager::maintenanceLoop, this, interval);
+}
+
+// Stops the maintenance thread; queued frees stay queued until the next drain
+void MemoryManager::stopMaintenanceThread() {
+    if (!maintenanceThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        maintenanceStop = true;
+    }
+    maintenanceWake.notify_all();
+    maintenanceThread.join();
+}
+
+// Dumps the holes to a file as [offset, length] - [offset, length] ...
+int MemoryManager::dumpMemoryMap(char* filename) {
+    ArenaLock lock(*this);
+    std::ofstream outfile(filename);
+    if (!outfile) {
+        return -1;
+    }
+
+    bool first = true;
+    for (const auto& hole : holes) {
+        outfile << (first ? "[" : " - [") << hole.first << ", " << hole.second << "]";
+        first = false;
+    }
+    outfile << std::endl;
+    outfile.close();
+    return 0;
+}
+
+// Returns the list of memory holes as [count, offset, length, ...]
+void* MemoryManager::getList() {
+	ArenaLock lock(*this);
+	// Check if memory is initialized
+	if (!memoryStart) {
+		return nullptr;
+	}
+
+	// Return nullptr if there are no free blocks
+	if (holes.empty()) {
+		return nullptr;
+	}
+
+	// Allocate a dynamic array to store the free block data in little-endian format
+	size_t listSize = holes.size() * 2; // Each free block has an offset and length
+	uint16_t* holeList = new uint16_t[listSize + 1]; // +1 for the count of holes at the start
+	holeList[0] = static_cast<uint16_t>(holes.size()); // Number of free blocks
+
+	// Fill in the offset and length for each free block
+	size_t i = 0;
+	for (const auto& hole : holes) {
+		holeList[2 * i + 1] = static_cast<uint16_t>(hole.first);  // Offset of free block
+		holeList[2 * i + 2] = static_cast<uint16_t>(hole.second); // Length of free block
+		++i;
+	}
+
+	// Return the array as a void pointer
+	return static_cast<void*>(holeList);
+}
+
+// Generates a bitmap representing allocated and free blocks, prefixed with
+// its length in bytes (little-endian uint16_t)
+void* MemoryManager::getBitmap() {
+    ArenaLock lock(*this);
+    int numWords = memoryLimit / wordSize;
+    int bitmapSize = (numWords + 7) / 8;
+
+    uint8_t* bitmap = new uint8_t[bitmapSize + 2](); // new: initializes bitmap array to all 0s
+    bitmap[0] = static_cast<uint8_t>(bitmapSize & 0xFF);
+    bitmap[1] = static_cast<uint8_t>((bitmapSize >> 8) & 0xFF);
+    fillBitmap(0, numWords, bitmap + 2);
+    return bitmap;
+}
+
+// Sets bit i of bitmap for each allocated word firstWord + i; bitmap must
+// start zeroed. Caller holds the lock.
+void MemoryManager::fillBitmap(size_t firstWord, size_t words, uint8_t* bitmap) const {
+    // Word-aligned ranges copy the hot bitmap eight bits at a time, its bytes
+    // are already in this order on a little-endian host
+    size_t i = 0;
+    if (firstWord % 64 == 0 && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+        std::memcpy(bitmap, allocatedBits.data() + firstWord / 64, words / 8);
+        i = words / 8 * 8;
+    }
+    for (; i < words; ++i) {
+        if (allocationStatus[firstWord + i] & kAllocated) { // checks if each word is allocated
+            bitmap[i / 8] |= (1 << (i % 8)); // sets the bit for allocated words
+        }
+    }
+
+    // The small class region is one block; report its slots individually
+    size_t slotWords = smallClassSlotWords.load(std::memory_order_acquire);
+    for (size_t slot = 0; slotWords > 0 && slot < smallClassSlotCount; ++slot) {
+        size_t slotStart = smallClassOffset + slot * slotWords;
+        if (slotStart + slotWords <= firstWord || slotStart >= firstWord + words) {
+            continue;
+        }
+        bool inUse = smallClassBits[slot / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (slot % 64));
+        for (size_t word = 0; word < slotWords && !inUse; ++word) {
+            size_t i = slotStart + word;
+            if (i >= firstWord && i < firstWord + words) {
+                bitmap[(i - firstWord) / 8] &= ~(1 << ((i - firstWord) % 8));
+            }
+        }
+    }
+}
+
+// Replaces the hardening settings; blocks already guarded keep their guards
+void MemoryManager::setHardening(const HardeningOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    hardening = options;
+}
+
+// Starts sampling from a clean table; 0 bytes stops it
+void MemoryManager::startProfiling(size_t sampleBytes) {
+    void* warmUp[1];
+    backtrace(warmUp, 1); // the first call loads the unwinder, which allocates
+    std::lock_guard<std::mutex> lock(mutex);
+    heapSamples.clear();
+    profileSampleBytes = sampleBytes;
+    if (sampleBytes > 0) {
+        profileRandom.seed(sampleBytes);
+        std::exponential_distribution<double> gap(1.0 / sampleBytes);
+        profileCountdown = static_cast<size_t>(gap(profileRandom)) + 1;
+    }
+}
+
+void MemoryManager::stopProfiling() {
+    std::lock_guard<std::mutex> lock(mutex);
+    profileSampleBytes = 0;
+    heapSamples.clear();
+}
+
+// Counts the allocation against the countdown and, when it runs out, records
+// the stack from caller outward and draws the next sample point. Caller holds
+// the lock.
+void MemoryManager::recordSample(size_t offset, size_t sizeInBytes, const void* caller) {
+    if (sizeInBytes < profileCountdown) {
+        profileCountdown -= sizeInBytes;
+        return;
+    }
+    std::exponential_distribution<double> gap(1.0 / profileSampleBytes);
+    profileCountdown = static_cast<size_t>(gap(profileRandom)) + 1;
+
+    void* frames[64];
+    int depth = backtrace(frames, 64);
+    // Matching the return address skips our own frames however many were
+    // inlined or tail called away
+    int skipped = std::find(frames, frames + depth, caller) - frames;
+    HeapSample& sample = heapSamples[offset];
+    sample.sizeInBytes = sizeInBytes;
+    sample.offset = offset;
+    sample.stack.assign(frames + (skipped < depth ? skipped : 0), frames + depth);
+}
+
+std::vector<HeapSample> MemoryManager::getHeapSamples() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<HeapSample> samples;
+    for (const auto& sample : heapSamples) {
+        samples.push_back(sample.second);
+    }
+    return samples;
+}
+
+// Writes the gperftools text heap profile pprof reads: a header with the
+// totals and sampling period, one line per distinct stack, then the
+// process's mappings so pprof can symbolize the addresses
+int MemoryManager::dumpHeapProfile(const char* filename) const {
+    std::map<std::vector<void*>, std::pair<size_t, size_t>> stacks; // stack -> count, bytes
+    size_t period;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        period = profileSampleBytes;
+        for (const auto& sample : heapSamples) {
+            std::pair<size_t, size_t>& totals = stacks[sample.second.stack];
+            ++totals.first;
+            totals.second += sample.second.sizeInBytes;
+        }
+    }
+
+    std::ofstream outfile(filename);
+    if (!outfile) {
+        return -1;
+    }
+    size_t count = 0;
+    size_t bytes = 0;
+    for (const auto& stack : stacks) {
+        count += stack.second.first;
+        bytes += stack.second.second;
+    }
+    outfile << "heap profile: " << count << ": " << bytes << " [" << count << ": " << bytes << "] @ heap_v2/" << period << "\n";
+    for (const auto& stack : stacks) {
+        outfile << stack.second.first << ": " << stack.second.second << " [" << stack.second.first << ": "
+                << stack.second.second << "] @";
+        for (void* frame : stack.first) {
+            outfile << " " << frame;
+        }
+        outfile << "\n";
+    }
+    outfile << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    outfile << maps.rdbuf();
+    outfile.close();
+    return 0;
+}
+
+// Enables or pauses change tracking. Enabling marks every chunk changed,
+// since nothing was recorded while it was off.
+void MemoryManager::setChangeTracking(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (enabled && !changeTracking.load()) {
+        resetChangeTracking(allocationStatus.size());
+    }
+    changeTracking.store(enabled, std::memory_order_release);
+}
+
+// Returns the bitmap of every chunk stamped after sinceEpoch
+BitmapDelta MemoryManager::getBitmapDelta(uint64_t sinceEpoch) {
+    ArenaLock lock(*this);
+    BitmapDelta delta;
+    delta.epoch = deltaEpoch(sinceEpoch);
+    size_t numWords = allocationStatus.size();
+    bool tracking = changeTracking.load();
+    for (size_t chunk = 0; chunk * kChangeChunkWords < numWords; ++chunk) {
+        if (!tracking || chunkEpochs[chunk].load(std::memory_order_relaxed) > sinceEpoch) {
+            size_t firstWord = chunk * kChangeChunkWords;
+            size_t words = std::min(kChangeChunkWords, numWords - firstWord);
+            delta.chunks.push_back(BitmapChunk{firstWord, words, std::vector<uint8_t>((words + 7) / 8)});
+            fillBitmap(firstWord, words, delta.chunks.back().bitmap.data());
+        }
+    }
+    return delta;
+}
+
+// Returns the holes that start or end in a chunk stamped after sinceEpoch
+ListDelta MemoryManager::getListDelta(uint64_t sinceEpoch) {
+    ArenaLock lock(*this);
+    ListDelta delta;
+    delta.epoch = deltaEpoch(sinceEpoch);
+    delta.chunkWords = kChangeChunkWords;
+    bool tracking = changeTracking.load();
+    std::map<size_t, size_t> touched;
+    for (size_t chunk = 0; chunk * kChangeChunkWords < allocationStatus.size(); ++chunk) {
+        if (tracking && chunkEpochs[chunk].load(std::memory_order_relaxed) <= sinceEpoch) {
+            continue;
+        }
+        delta.chunks.push_back(chunk);
+        size_t first = chunk * kChangeChunkWords;
+        size_t last = first + kChangeChunkWords;
+        auto hole = holes.lower_bound(first);
+        if (hole != holes.begin()) {
+            auto before = std::prev(hole); // starts earlier, may end in this chunk
+            if (before->first + before->second > first && before->first + before->second <= last) {
+                touched.insert(*before);
+            }
+        }
+        for (; hole != holes.end() && hole->first < last; ++hole) {
+            touched.insert(*hole);
+        }
+    }
+    for (const auto& hole : touched) {
+        delta.holes.push_back(Hole{hole.first, hole.second});
+    }
+    return delta;
+}
+
+// Returns the epoch for a delta scanned after this call. The small class
+// stamps without the lock, so a stamper may hold an epoch it has not written
+// yet; until none does, the caller's epoch is handed back and the next call
+// looks at the same chunks again.
+uint64_t MemoryManager::deltaEpoch(uint64_t sinceEpoch) const {
+    uint64_t epoch = changeEpoch.load();
+    return changeStampers.load() == 0 ? epoch : sinceEpoch;
+}
+
+// Stamps every chunk that holds a word of [firstWord, lastWord] with a new epoch
+void MemoryManager::markChanged(size_t firstWord, size_t lastWord) {
+    if (!changeTracking.load(std::memory_order_acquire) || chunkCount == 0) {
+        return;
+    }
+    changeStampers.fetch_add(1);
+    uint64_t epoch = changeEpoch.fetch_add(1) + 1;
+    size_t lastChunk = std::min(lastWord / kChangeChunkWords, chunkCount - 1);
+    for (size_t chunk = firstWord / kChangeChunkWords; chunk <= lastChunk; ++chunk) {
+        chunkEpochs[chunk].store(epoch, std::memory_order_relaxed);
+    }
+    changeStampers.fetch_sub(1);
+}
+
+// Stamps every chunk newer than any epoch handed out. The stamps are only
+// reallocated when the arena size changes, as the small class may still be
+// writing to them.
+void MemoryManager::resetChangeTracking(size_t sizeInWords) {
+    size_t chunks = (sizeInWords + kChangeChunkWords - 1) / kChangeChunkWords;
+    if (chunks != chunkCount || !chunkEpochs) {
+        chunkCount = chunks;
+        chunkEpochs.reset(new std::atomic<uint64_t>[chunkCount]);
+    }
+    uint64_t epoch = changeEpoch.fetch_add(1) + 1;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        chunkEpochs[chunk].store(epoch, std::memory_order_relaxed);
+    }
+}
+
+// Returns a view over the live hole index
+HoleView MemoryManager::getHoles() const {
+    return HoleView(holes);
+}
+
+// Returns usage counters; hole figures are computed from the hole index
+MemoryStats MemoryManager::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryStats stats = MemoryStats();
+    stats.totalWords = allocationStatus.size();
+    stats.usedWords = usedWords;
+    stats.requestedWords = requestedWords;
+    stats.freeWords = stats.totalWords - usedWords;
+    stats.holeCount = holes.size();
+    for (const auto& hole : holes) {
+        stats.largestHole = hole.second > stats.largestHole ? hole.second : stats.largestHole;
+    }
+    stats.allocations = allocationCount;
+    stats.failedAllocations = failedAllocationCount;
+    stats.frees = freeCount;
+    stats.pendingFrees = deferredPending.load();
+    for (const auto& sizeClass : asyncWaiters) {
+        stats.waitingAllocations += sizeClass.second.size();
+    }
+    if (smallClassSlotWords.load() > 0) {
+        stats.smallClassSlots = smallClassSlotCount;
+        for (size_t i = 0; i < smallClassBitmapWords; ++i) {
+            stats.smallClassSlotsInUse += __builtin_popcountll(smallClassBits[i].load(std::memory_order_relaxed));
+        }
+        stats.smallClassSlotsInUse -= smallClassBitmapWords * 64 - smallClassSlotCount; // padding bits
+    }
+    stats.internalFragmentation = usedWords ? 1.0 - static_cast<double>(requestedWords) / usedWords : 0.0;
+    stats.externalFragmentation = stats.freeWords ? 1.0 - static_cast<double>(stats.largestHole) / stats.freeWords : 0.0;
+    stats.nodes = nodeStats;
+    stats.hardenedAllocations = hardenedAllocationCount;
+    stats.guardViolations = guardViolationCount;
+    stats.doubleFrees = doubleFreeCount;
+    stats.invalidFrees = invalidFreeCount;
+    stats.zeroFillSkippedWords = zeroFillSkippedCount;
+    stats.pressure = pressure;
+    stats.reclaimPasses = reclaimPassCount;
+    stats.reclaimedAllocations = reclaimedAllocationCount;
+    return stats;
+}
+
+// Returns the word size
+unsigned MemoryManager::getWordSize() {
+    return wordSize;
+}
+
+// Returns the starting address of memory
+void* MemoryManager::getMemoryStart() {
+    return memoryStart;
+}
+
+// Returns the memory limit in bytes
+unsigned MemoryManager::getMemoryLimit() {
+    return memoryLimit;
+}
+
+// Carves the small class region out of the arena and builds its bitmap
+bool MemoryManager::enableSmallClass(size_t sizeInBytes, size_t slotCount) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (memoryStart == nullptr || sharedHeader != nullptr || sizeInBytes == 0 || slotCount == 0 ||
+        smallClassSlotWords.load() != 0) {
+        return false;
+    }
+
+    size_t slotWords = (sizeInBytes + wordSize - 1) / wordSize;
+    int offset = placeBlock(slotWords * slotCount);
+    if (offset < 0) {
+        return false;
+    }
+    if (mode == AllocationMode::Buddy) {
+        buddyRequested[offset] = slotWords * slotCount;
+    }
+    requestedWords += slotWords * slotCount;
+
+    smallClassOffset = offset;
+    smallClassSlotCount = slotCount;
+    smallClassBitmapWords = (slotCount + 63) / 64;
+    smallClassBits.reset(new std::atomic<uint64_t>[smallClassBitmapWords]);
+    for (size_t i = 0; i < smallClassBitmapWords; ++i) {
+        smallClassBits[i].store(0, std::memory_order_relaxed);
+    }
+    if (slotCount % 64 != 0) {
+        // bits past the last slot stay set so they are never handed out
+        smallClassBits[smallClassBitmapWords - 1].store(~uint64_t(0) << (slotCount % 64), std::memory_order_relaxed);
+    }
+    smallClassSlotWords.store(slotWords, std::memory_order_release);
+    return true;
 }
 
-// Destructor to shut down memory manager when object is destroyed
-MemoryManager::~MemoryManager() {
-    shutdown();
+// Scans the bitmap from a per-thread starting word, so threads mostly CAS on
+// different cache lines, and claims the lowest clear bit of the first word
+// that has one
+void* MemoryManager::allocateSmall() {
+    static std::atomic<size_t> nextHint(0);
+    thread_local size_t hint = nextHint.fetch_add(1, std::memory_order_relaxed);
+
+    size_t slotWords = smallClassSlotWords.load(std::memory_order_acquire);
+    for (size_t i = 0; i < smallClassBitmapWords; ++i) {
+        size_t index = (hint + i) % smallClassBitmapWords;
+        std::atomic<uint64_t>& bits = smallClassBits[index];
+        uint64_t current = bits.load(std::memory_order_relaxed);
+        while (~current != 0) {
+            int bit = __builtin_ctzll(~current);
+            if (bits.compare_exchange_weak(current, current | (uint64_t(1) << bit), std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                size_t slot = index * 64 + bit;
+                markChanged(smallClassOffset + slot * slotWords, smallClassOffset + (slot + 1) * slotWords - 1);
+                return memoryStart + (smallClassOffset + slot * slotWords) * wordSize;
+            }
+        }
+    }
+
+    return nullptr;
 }
 
-// Initializes memory with a specified number of words
-void MemoryManager::initialize(size_t sizeInWords) {
-    if (sizeInWords > 65536) { // new: checks the maximum word limit
-        std::cout << "Initialization failed: Exceeds maximum word limit of 65536." << std::endl;
-        return;
+// Clears the slot's bit; addresses inside the region that are not slot
+// starts and slots that are already free are ignored
+bool MemoryManager::freeSmall(void* address) {
+    size_t slotWords = smallClassSlotWords.load(std::memory_order_acquire);
+    if (slotWords == 0) {
+        return false;
     }
 
-    if (memoryStart != nullptr) {
-        delete[] memoryStart;
+    char* regionStart = memoryStart + smallClassOffset * wordSize;
+    size_t slotBytes = slotWords * wordSize;
+    char* block = static_cast<char*>(address);
+    if (block < regionStart || block >= regionStart + smallClassSlotCount * slotBytes) {
+        return false;
     }
 
-    memoryStart = new char[sizeInWords * wordSize];
-    memoryLimit = sizeInWords * wordSize;
-    allocationStatus.resize(sizeInWords, false); // new: initializes all words as free
+    size_t byteOffset = block - regionStart;
+    size_t slot = byteOffset / slotBytes;
+    uint64_t bit = uint64_t(1) << (slot % 64);
+    bool wasInUse = false;
+    if (byteOffset % slotBytes == 0) {
+        wasInUse = smallClassBits[slot / 64].fetch_and(~bit, std::memory_order_release) & bit;
+        markChanged(smallClassOffset + slot * slotWords, smallClassOffset + (slot + 1) * slotWords - 1);
+    }
+    if (!wasInUse) {
+        std::lock_guard<std::mutex> lock(mutex); // only taken on the error path
+        if (hardening.enabled) {
+            size_t offset = (block - memoryStart) / wordSize;
+            reportViolation(byteOffset % slotBytes == 0 ? Violation::DoubleFree : Violation::InvalidFree, offset);
+        }
+    }
+    return true;
 }
 
-// Shuts down the memory manager and releases resources
-void MemoryManager::shutdown() {
-    if (memoryStart != nullptr) {
-        delete[] memoryStart;
-        memoryStart = nullptr;
-        memoryLimit = 0;
+// Claims words for a block through the buddy lists or the placement policy
+int MemoryManager::placeBlock(size_t wordsNeeded, size_t alignment) {
+    // An alignment stricter than a word asks the policy for enough extra
+    // words to reach the next aligned one, which comes round every `period`
+    size_t padWords = 0;
+    if (!wordAligned(alignment)) {
+        size_t period = alignment / std::gcd<size_t>(alignment, wordSize);
+        if (mode == AllocationMode::Buddy || reinterpret_cast<uintptr_t>(memoryStart) % (alignment / period) != 0) {
+            return -1; // no word in the arena is aligned
+        }
+        padWords = period - 1;
+    }
+
+    if (mode == AllocationMode::Buddy) {
+        return placeBuddy(wordsNeeded);
+    }
+
+    // With NUMA partitions the caller's node is tried first, then the others in order
+    size_t partitions = nodeStats.size();
+    size_t home = partitions > 1 ? callerNode() : 0;
+    int offset = -1;
+    for (size_t i = 0; i < std::max<size_t>(partitions, 1) && offset < 0; ++i) {
+        size_t node = (home + i) % std::max<size_t>(partitions, 1);
+        HoleView view = partitions > 1
+            ? HoleView(holes, node * partitionWords, (node + 1) * partitionWords)
+            : getHoles();
+        offset = policy->place(wordsNeeded + padWords, view);
+        if (offset >= 0 && partitions > 1) {
+            // The policy is confined to the view it was handed
+            if (static_cast<size_t>(offset) / partitionWords != node) {
+                return -1;
+            }
+            if (i == 0) {
+                ++nodeStats[node].localAllocations;
+            }
+            else {
+                ++nodeStats[node].remoteAllocations;
+            }
+        }
+    }
+
+    // The policy is untrusted: the offset must land inside a hole with room to spare
+    if (offset < 0) {
+        return -1;
+    }
+    auto hole = holes.upper_bound(offset);
+    if (hole == holes.begin()) {
+        return -1;
+    }
+    --hole;
+    if (static_cast<size_t>(offset) + wordsNeeded + padWords > hole->first + hole->second) {
+        return -1;
+    }
+
+    while (padWords > 0 && (reinterpret_cast<uintptr_t>(memoryStart) + size_t(offset) * wordSize) % alignment != 0) {
+        ++offset;
     }
+    markAllocated(offset, wordsNeeded);
+    return offset;
 }
 
-void* MemoryManager::allocate(size_t sizeInBytes) {
-    size_t wordsNeeded = (sizeInBytes + wordSize - 1) / wordSize;
+// Releases the block that starts at offset; anything else is ignored
+bool MemoryManager::releaseBlock(size_t offset) {
+    if (!checkFree(offset)) {
+        return false; // not the start of a live block
+    }
+    if (!heapSamples.empty()) {
+        heapSamples.erase(offset);
+    }
+    ++freeCount;
+
+    if (mode == AllocationMode::Buddy) {
+        freeBuddy(offset);
+        return true;
+    }
+
+    size_t length = blockLength(offset);
+    requestedWords -= length;
+    markFree(offset, length);
+    return true;
+}
+
+// Accepts offset only if it starts a live unguarded block or is the first
+// word handed out of a hardened one, which is moved back to its block start
+// after its guards are checked and its contents poisoned. A hardened block's
+// own start is its front guard and is rejected. Rejections are reported in
+// hardened mode.
+bool MemoryManager::checkFree(size_t& offset) {
+    uint8_t status = offset < allocationStatus.size() ? allocationStatus[offset] : 0;
+    bool guardStart = (status & kBlockStart) && (status & kGuarded);
+    if (!(status & kAllocated) || !(status & (kBlockStart | kGuarded)) || guardStart) {
+        if (hardening.enabled) {
+            reportViolation(offset < allocationStatus.size() && !(status & kAllocated) ? Violation::DoubleFree
+                                                                                       : Violation::InvalidFree, offset);
+        }
+        return false;
+    }
+    if (!(status & kGuarded)) {
+        return true;
+    }
 
-    // Debug output to check the parameters
-    std::cout << "Calling allocator with wordsNeeded: " << wordsNeeded << std::endl;
-    std::cout << "Allocation status address: " << static_cast<void*>(allocationStatus.data()) << std::endl;
+    size_t start = offset;
+    while (!(allocationStatus[start] & kBlockStart)) {
+        --start; // only guard words lie between
+    }
+    size_t guardWords = offset - start;
+    size_t words = mode == AllocationMode::Buddy ? buddyRequested[start] : blockLength(start);
+    const uint8_t* front = reinterpret_cast<uint8_t*>(memoryStart + start * wordSize);
+    const uint8_t* back = front + (words - guardWords) * wordSize;
+    bool intact = true;
+    for (size_t i = 0; i < guardWords * wordSize && intact; ++i) {
+        intact = front[i] == kCanaryByte && back[i] == kCanaryByte;
+    }
+    if (!intact) {
+        reportViolation(Violation::GuardCorrupted, offset);
+    }
+    if (hardening.poison) {
+        std::memset(memoryStart + offset * wordSize, kPoisonByte, (words - 2 * guardWords) * wordSize);
+    }
+    offset = start;
+    return true;
+}
 
-    int offset = allocator(wordsNeeded, allocationStatus.data());
+// Fills guardWords (at least one) at each end of [offset, offset + words)
+// with canary and marks the front guard and the first word after it, the
+// block's handle. The whole block is journaled again, so a crash in between
+// frees it rather than leaving words without a block start.
+void MemoryManager::armBlock(size_t offset, size_t words, size_t guardWords) {
+    std::memset(memoryStart + offset * wordSize, kCanaryByte, guardWords * wordSize);
+    std::memset(memoryStart + (offset + words - guardWords) * wordSize, kCanaryByte, guardWords * wordSize);
+    allocationStatus[offset] |= kGuarded;
+    allocationStatus[offset + guardWords] |= kGuarded;
+    if (sharedStatus != nullptr) {
+        mirrorShared(offset, words);
+    }
+    ++hardenedAllocationCount;
+}
 
-    // Debug output to check the result from allocator
-    std::cout << "Allocator returned offset: " << offset << std::endl;
+void MemoryManager::reportViolation(Violation violation, size_t offset) {
+    switch (violation) {
+    case Violation::GuardCorrupted:
+        ++guardViolationCount;
+        break;
+    case Violation::DoubleFree:
+        ++doubleFreeCount;
+        break;
+    case Violation::InvalidFree:
+        ++invalidFreeCount;
+        break;
+    }
+    if (hardening.onViolation) {
+        hardening.onViolation(violation, offset);
+    }
+}
 
-    if (offset < 0 || (offset + wordsNeeded) * wordSize > memoryLimit) return nullptr;
+// The block runs until the next block start or free word
+// Scans the hot bitmaps 64 words at a time: the block ends at the first word
+// that is free or starts another block. Bits past the arena read as free.
+size_t MemoryManager::blockLength(size_t offset) const {
+    size_t end = offset + 1;
+    while (end < allocationStatus.size()) {
+        uint64_t stop = (~allocatedBits[end / 64] | blockStartBits[end / 64]) >> (end % 64);
+        if (stop != 0) {
+            end += __builtin_ctzll(stop);
+            break;
+        }
+        end += 64 - end % 64;
+    }
+    return std::min(end, allocationStatus.size()) - offset;
+}
 
-    for (size_t i = 0; i < wordsNeeded; ++i)
-        allocationStatus[offset + i] = true;
+// Treiber-style push onto the deferred list. A word's link doubles as its
+// queued flag, so a second free of the same block before the drain is dropped,
+// and reported in hardened mode.
+void MemoryManager::pushDeferred(size_t offset) {
+    if (!deferredNext) {
+        return;
+    }
+    uint32_t idle = kDeferredIdle;
+    if (!deferredNext[offset].compare_exchange_strong(idle, kDeferredEnd)) {
+        std::lock_guard<std::mutex> lock(mutex); // only taken on the error path
+        if (hardening.enabled) {
+            reportViolation(Violation::DoubleFree, offset);
+        }
+        return;
+    }
 
-    return static_cast<char*>(memoryStart) + (offset * wordSize);
+    uint32_t head = deferredHead.load();
+    do {
+        deferredNext[offset].store(head);
+    } while (!deferredHead.compare_exchange_weak(head, static_cast<uint32_t>(offset)));
+    deferredPending.fetch_add(1);
 }
 
-// Frees a previously allocated block
-void MemoryManager::free(void* address) {
-    if (address == nullptr || address < memoryStart || address >= (static_cast<char*>(memoryStart) + memoryLimit)) {
-        return; // does nothing if the address is invalid or out of range
+// Takes the whole deferred list in one exchange, sorts it by address and
+// releases it. In placement mode adjacent blocks are merged into one run
+// first, so the hole index is updated once per run instead of once per block.
+size_t MemoryManager::drainDeferred() {
+    if (!deferredNext) {
+        return 0;
     }
+    uint32_t offset = deferredHead.exchange(kDeferredEnd);
+    if (offset == kDeferredEnd) {
+        return 0;
+    }
+
+    drainBatch.clear();
+    while (offset != kDeferredEnd) {
+        uint32_t next = deferredNext[offset].load();
+        drainBatch.push_back(offset);
+        deferredNext[offset].store(kDeferredIdle);
+        offset = next;
+    }
+    deferredPending.fetch_sub(drainBatch.size());
+    std::sort(drainBatch.begin(), drainBatch.end());
 
-    size_t offset = (static_cast<char*>(address) - static_cast<char*>(memoryStart)) / wordSize;
-    size_t i = offset;
+    size_t released = 0;
+    if (mode == AllocationMode::Buddy) {
+        for (uint32_t block : drainBatch) {
+            released += releaseBlock(block) ? 1 : 0;
+        }
+        return released;
+    }
 
-    while (i < allocationStatus.size() && allocationStatus[i]) { // new: frees blocks until unallocated block
-        allocationStatus[i] = false;
-        ++i;
+    size_t runStart = 0;
+    size_t runLength = 0;
+    for (uint32_t queued : drainBatch) {
+        size_t block = queued;
+        if (!checkFree(block)) {
+            continue; // stale or invalid pointer
+        }
+        if (!heapSamples.empty()) {
+            heapSamples.erase(block);
+        }
+        size_t length = blockLength(block);
+        ++freeCount;
+        ++released;
+        requestedWords -= length;
+        if (runLength > 0 && runStart + runLength == block && block % partitionWords != 0) { // runs stop at partitions
+            runLength += length;
+            continue;
+        }
+        if (runLength > 0) {
+            markFree(runStart, runLength);
+        }
+        runStart = block;
+        runLength = length;
+    }
+    if (runLength > 0) {
+        markFree(runStart, runLength);
     }
+
+    return released;
 }
 
-// Sets the allocator function to either bestFit or worstFit
-void MemoryManager::setAllocator(std::function<int(int, void*)> allocator) {
-    this->allocator = allocator;
+// Drains the deferred list every interval until stopMaintenanceThread()
+void MemoryManager::maintenanceLoop(std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!maintenanceStop) {
+        WokenWaiters woken;
+        lockShared();
+        drainDeferred();
+        serveWaiters(woken);
+        PressureChange change = updatePressure();
+        unlockShared();
+        if (!woken.empty() || change.changed) {
+            lock.unlock();
+            runWaiters(woken);
+            notifyPressure(change);
+            lock.lock();
+        }
+        maintenanceWake.wait_for(lock, interval, [this] { return maintenanceStop; });
+    }
 }
 
-// Dumps the memory map to a file (stubbed functionality)
-int MemoryManager::dumpMemoryMap(char* filename) {
-    std::ofstream outfile(filename);
-    if (!outfile) {
+// Pops the lowest free block of the smallest sufficient order and splits it
+// down, returning the upper halves to their free lists
+int MemoryManager::placeBuddy(size_t wordsNeeded) {
+    uint8_t order = orderFor(wordsNeeded);
+    size_t available = order;
+    while (available < buddyFreeLists.size() && buddyFreeLists[available].empty()) {
+        ++available;
+    }
+    if (available >= buddyFreeLists.size()) {
         return -1;
     }
-    outfile << "Memory map output (to be implemented)" << std::endl; // new: placeholder for dumping memory map
-    outfile.close();
-    return 0;
+
+    size_t offset = *buddyFreeLists[available].begin();
+    buddyFreeLists[available].erase(buddyFreeLists[available].begin());
+    while (available > order) {
+        --available;
+        buddyFreeLists[available].insert(offset + (size_t(1) << available));
+    }
+
+    markAllocated(offset, size_t(1) << order, order);
+    return static_cast<int>(offset);
 }
 
-// Placeholder function for getting a list of memory holes
-void* MemoryManager::getList() {
-	// Check if memory is initialized
-	if (!memoryStart) {
-		return nullptr;
-	}
+// Merges the block with its buddy (offset XOR size) while the buddy is free
+// and of the same order
+void MemoryManager::freeBuddy(size_t offset) {
+    size_t order = allocationStatus[offset] >> kOrderShift;
+    markFree(offset, size_t(1) << order);
 
-	// Vector to temporarily store free blocks' (offset, length) pairs
-	std::vector<std::pair<uint16_t, uint16_t>> freeBlocks;
-
-	uint16_t startIdx = 0;
-	uint16_t currentBlockSize = 0;
-	bool inFreeBlock = false;
-
-	for (uint16_t i = 0; i < allocationStatus.size(); ++i) {
-		if (!allocationStatus[i]) { // Free block found
-			if (!inFreeBlock) { // Start of a new free block
-				startIdx = i;
-				inFreeBlock = true;
-			}
-			++currentBlockSize;
-		}
-		else if (inFreeBlock) { // End of a free block
-			freeBlocks.emplace_back(startIdx, currentBlockSize);
-			inFreeBlock = false;
-			currentBlockSize = 0;
-		}
-	}
+    auto requested = buddyRequested.find(offset);
+    if (requested != buddyRequested.end()) {
+        requestedWords -= requested->second;
+        buddyRequested.erase(requested);
+    }
 
-	// If the last segment was free, add it to the list
-	if (inFreeBlock) {
-		freeBlocks.emplace_back(startIdx, currentBlockSize);
-	}
+    while (order + 1 < buddyFreeLists.size()) {
+        size_t buddy = offset ^ (size_t(1) << order);
+        if (buddyFreeLists[order].erase(buddy) == 0) {
+            break; // buddy is allocated, split, or past the end of the arena
+        }
+        offset = offset < buddy ? offset : buddy;
+        ++order;
+    }
+    buddyFreeLists[order].insert(offset);
+}
 
-	// Return nullptr if there are no free blocks
-	if (freeBlocks.empty()) {
-		return nullptr;
-	}
+// Marks [offset, offset + words) as one block and trims the hole it was
+// carved from. The hole is shrunk or replaced in place, so at most one
+// insert moves the index.
+void MemoryManager::markAllocated(size_t offset, size_t words, uint8_t order) {
+    auto hole = --holes.upper_bound(offset);
+    size_t holeStart = hole->first;
+    size_t holeEnd = hole->first + hole->second;
+    if (holeStart < offset) {
+        hole->second = offset - holeStart;
+        if (offset + words < holeEnd) {
+            holes.insert(hole + 1, offset + words, holeEnd - (offset + words));
+        }
+    }
+    else if (offset + words < holeEnd) {
+        *hole = HoleIndex::value_type(offset + words, holeEnd - (offset + words));
+    }
+    else {
+        holes.erase(hole);
+    }
 
-	// Allocate a dynamic array to store the free block data in little-endian format
-	size_t listSize = freeBlocks.size() * 2; // Each free block has an offset and length
-	uint16_t* holeList = new uint16_t[listSize + 1]; // +1 for the count of holes at the start
-	holeList[0] = static_cast<uint16_t>(freeBlocks.size()); // Number of free blocks
+    // The block, the ends of what is left on either side, and the old hole's ends
+    markChanged(offset ? offset - 1 : 0, offset + words);
+    markChanged(holeStart, holeStart);
+    markChanged(holeEnd - 1, holeEnd - 1);
 
-	// Fill in the offset and length for each free block
-	for (size_t i = 0; i < freeBlocks.size(); ++i) {
-		holeList[2 * i + 1] = freeBlocks[i].first;  // Offset of free block
-		holeList[2 * i + 2] = freeBlocks[i].second; // Length of free block
-	}
+    allocationStatus[offset] = kAllocated | kBlockStart | (order << kOrderShift);
+    for (size_t i = 1; i < words; ++i) {
+        allocationStatus[offset + i] = kAllocated;
+    }
+    setBits(allocatedBits, offset, words);
+    setBits(blockStartBits, offset, 1);
+    usedWords += words;
+    if (!nodeStats.empty()) {
+        nodeStats[offset / partitionWords].usedWords += words;
+    }
+    if (sharedStatus != nullptr) {
+        mirrorShared(offset, words);
+    }
+}
 
-	// Return the array as a void pointer
-	return static_cast<void*>(holeList);
+// Returns the arena to wherever it came from. The creator of a shared
+// segment also removes its name; processes still attached keep their
+// mapping. A file-backed arena is written back before it is unmapped and
+// its file lock is dropped after.
+void MemoryManager::releaseArena() {
+    if (sharedHeader != nullptr) {
+        if (sharedFileFd >= 0) {
+            msync(sharedHeader, sharedBytes, MS_SYNC);
+        }
+        munmap(sharedHeader, sharedBytes);
+        if (sharedFileFd >= 0) {
+            close(sharedFileFd); // drops the file lock
+        }
+        if (sharedOwner) {
+            shm_unlink(sharedName.c_str());
+        }
+    }
+    else if (memoryStart != nullptr) {
+        if (arenaMapped) {
+            munmap(memoryStart, memoryLimit);
+        }
+        else {
+            delete[] memoryStart;
+        }
+    }
+    memoryStart = nullptr;
+    memoryLimit = 0;
+    arenaMapped = false;
+    sharedHeader = nullptr;
+    sharedStatus = nullptr;
+    sharedBytes = 0;
+    sharedName.clear();
+    sharedOwner = false;
+    sharedFileFd = -1;
+    sharedDirty = false;
 }
 
-// Generates a bitmap representing allocated and free blocks
-void* MemoryManager::getBitmap() {
-    int numWords = memoryLimit / wordSize;
-    int bitmapSize = (numWords + 7) / 8;
+// Replaces any segment of the same name with one sized for the header, the
+// status bytes and the data
+bool MemoryManager::createShared(const char* name, size_t sizeInWords) {
+    size_t dataOffset;
+    size_t bytes = segmentBytes(sizeInWords, wordSize, dataOffset);
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0) { // the new segment reads as zeros: every word free
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    formatSegment(mapping, wordSize, sizeInWords, dataOffset);
+    adoptSegment(mapping, bytes);
+    sharedName = name;
+    sharedOwner = true;
+    return true;
+}
+
+// Points the arena at a mapped segment. The local metadata is marked stale
+// so the first locked call rebuilds it from the status bytes.
+void MemoryManager::adoptSegment(void* mapping, size_t bytes) {
+    sharedHeader = static_cast<SharedArenaHeader*>(mapping);
+    sharedStatus = reinterpret_cast<uint8_t*>(sharedHeader + 1);
+    sharedBytes = bytes;
+    sharedGeneration = UINT64_MAX;
+    memoryStart = static_cast<char*>(mapping) + sharedHeader->dataOffset;
+    memoryLimit = sharedHeader->words * wordSize;
+    mode = AllocationMode::Placement;
+    partitionWords = sharedHeader->words ? sharedHeader->words : 1;
+    cpuNode.clear();
+}
+
+// Copies status bytes into the segment under an intent record, so an update
+// cut short is undone by recoverJournal()
+void MemoryManager::mirrorShared(size_t offset, size_t words) {
+    sharedHeader->journalOffset = offset;
+    sharedHeader->journalWords = words;
+    sharedHeader->journalActive.store(1, std::memory_order_release);
+    std::copy(&allocationStatus[offset], &allocationStatus[offset] + words, sharedStatus + offset);
+    sharedHeader->journalActive.store(0, std::memory_order_release);
+    sharedDirty = true;
+}
 
-    uint8_t* bitmap = new uint8_t[bitmapSize](); // new: initializes bitmap array to all 0s
+// If the previous owner died holding the lock its update may be half
+// written; the journal undoes it before anyone reloads
+void MemoryManager::lockShared() {
+    if (sharedHeader == nullptr) {
+        return;
+    }
+    if (pthread_mutex_lock(&sharedHeader->lock) == EOWNERDEAD) {
+        recoverJournal(sharedHeader);
+        pthread_mutex_consistent(&sharedHeader->lock);
+    }
+    if (sharedHeader->generation.load() != sharedGeneration) {
+        reloadShared();
+    }
+}
+
+void MemoryManager::unlockShared() {
+    if (sharedHeader == nullptr) {
+        return;
+    }
+    if (sharedDirty) {
+        sharedGeneration = sharedHeader->generation.fetch_add(1) + 1;
+        sharedDirty = false;
+    }
+    pthread_mutex_unlock(&sharedHeader->lock);
+}
 
-    for (int i = 0; i < numWords; ++i) {
-        if (allocationStatus[i]) { // checks if each word is allocated
-            int byteIndex = i / 8;
-            int bitIndex = i % 8;
-            bitmap[byteIndex] |= (1 << bitIndex); // sets the bit for allocated words
+// Copies the segment's status bytes and derives holes and usage from them
+void MemoryManager::reloadShared() {
+    std::copy(sharedStatus, sharedStatus + allocationStatus.size(), allocationStatus.begin());
+    holes.clear();
+    std::fill(allocatedBits.begin(), allocatedBits.end(), 0);
+    std::fill(blockStartBits.begin(), blockStartBits.end(), 0);
+    usedWords = 0;
+    size_t run = 0;
+    for (size_t i = 0; i <= allocationStatus.size(); ++i) {
+        if (i < allocationStatus.size() && !(allocationStatus[i] & kAllocated)) {
+            ++run;
+            continue;
+        }
+        if (i < allocationStatus.size()) {
+            setBits(allocatedBits, i, 1);
+            if (allocationStatus[i] & kBlockStart) {
+                setBits(blockStartBits, i, 1);
+            }
+        }
+        if (run > 0) {
+            holes[i - run] = run;
         }
+        usedWords += i < allocationStatus.size() ? 1 : 0;
+        run = 0;
     }
+    requestedWords = usedWords; // placement blocks are exactly their request
+    if (!nodeStats.empty()) {
+        nodeStats[0].usedWords = usedWords;
+    }
+    sharedGeneration = sharedHeader->generation.load();
+    if (!allocationStatus.empty()) {
+        markChanged(0, allocationStatus.size() - 1); // another process may have changed anything
+    }
+}
 
-    return bitmap;
+// Binds each partition's whole pages to its node and first-touches it from a
+// thread running on that node. Only done when the machine has more than one
+// node; a forced split on a single node stays a plain arena.
+void MemoryManager::bindPartitions() {
+    std::vector<NumaNode> numaNodes = detectNumaNodes();
+    if (numaNodes.size() < 2 || !arenaMapped) {
+        return;
+    }
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<std::thread> touchers;
+    for (size_t partition = 0; partition < nodeStats.size(); ++partition) {
+        const NumaNode& node = numaNodes[partition % numaNodes.size()];
+        size_t begin = partition * partitionWords * wordSize;
+        size_t end = begin + nodeStats[partition].totalWords * wordSize;
+        size_t alignedBegin = (begin + page - 1) / page * page;
+        size_t alignedEnd = end / page * page;
+        if (alignedBegin < alignedEnd) {
+            bindToNode(memoryStart + alignedBegin, alignedEnd - alignedBegin, node.id);
+        }
+
+        char* start = memoryStart + begin;
+        size_t length = end - begin;
+        std::vector<int> cpus = node.cpus;
+        touchers.emplace_back([start, length, cpus]() {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            if (!cpus.empty()) {
+                sched_setaffinity(0, sizeof(set), &set);
+            }
+            std::memset(start, 0, length);
+        });
+    }
+    for (std::thread& toucher : touchers) {
+        toucher.join();
+    }
 }
 
-// Returns the word size
-unsigned MemoryManager::getWordSize() {
-    return wordSize;
+// Partition for the CPU the caller is running on
+size_t MemoryManager::callerNode() const {
+    int cpu = sched_getcpu();
+    size_t node = cpu >= 0 && static_cast<size_t>(cpu) < cpuNode.size() ? cpuNode[cpu] : 0;
+    return node % nodeStats.size();
 }
 
-// Returns the starting address of memory
-void* MemoryManager::getMemoryStart() {
-    return memoryStart;
+// Marks [offset, offset + words) free and coalesces it with adjacent holes,
+// growing a neighbour in place where there is one
+void MemoryManager::markFree(size_t offset, size_t words) {
+    // A range across a partition boundary is freed one partition at a time,
+    // so each node is charged for its own words and holes stay apart
+    size_t boundary = (offset / partitionWords + 1) * partitionWords;
+    if (offset + words > boundary) {
+        markFree(offset, boundary - offset);
+        markFree(boundary, offset + words - boundary);
+        return;
+    }
+
+    for (size_t i = 0; i < words; ++i) {
+        allocationStatus[offset + i] = 0;
+    }
+    clearBits(allocatedBits, offset, words);
+    clearBits(blockStartBits, offset, words);
+    setBits(dirtyBits, offset, words); // the block was handed out and may have been written
+    usedWords -= words;
+    if (!nodeStats.empty()) {
+        nodeStats[offset / partitionWords].usedWords -= words;
+    }
+    if (sharedStatus != nullptr) {
+        mirrorShared(offset, words);
+    }
+
+    // Holes never span a partition boundary
+    size_t start = offset;
+    size_t end = offset + words;
+    auto next = holes.lower_bound(offset);
+    bool mergeNext = next != holes.end() && next->first == end && end % partitionWords != 0;
+    bool mergePrev = next != holes.begin() && start % partitionWords != 0 &&
+                     std::prev(next)->first + std::prev(next)->second == start;
+    if (mergeNext) {
+        end += next->second;
+    }
+    if (mergePrev) {
+        auto prev = std::prev(next);
+        start = prev->first;
+        prev->second = end - start;
+        if (mergeNext) {
+            holes.erase(next);
+        }
+    }
+    else if (mergeNext) {
+        *next = HoleIndex::value_type(start, end - start);
+    }
+    else {
+        holes.insert(next, start, end - start);
+    }
+
+    // The block, the ends of the neighbours it merged with, and the new hole's ends
+    markChanged(offset ? offset - 1 : 0, offset + words);
+    markChanged(start, start);
+    markChanged(end - 1, end - 1);
 }
 
-// Returns the memory limit in bytes
-unsigned MemoryManager::getMemoryLimit() {
-    return memoryLimit;
+// Typed best fit: smallest hole that fits, stopping early on an exact fit
+int BestFitPolicy::place(size_t sizeInWords, const HoleView& holes) {
+    size_t smallestFitSize = SIZE_MAX;
+    int bestOffset = -1;
+
+    for (Hole hole : holes) {
+        if (hole.length >= sizeInWords && hole.length < smallestFitSize) {
+            smallestFitSize = hole.length;
+            bestOffset = static_cast<int>(hole.offset);
+            if (hole.length == sizeInWords) {
+                break; // cannot do better than an exact fit
+            }
+        }
+    }
+
+    return bestOffset;
+}
+
+// Typed worst fit: largest hole that fits
+int WorstFitPolicy::place(size_t sizeInWords, const HoleView& holes) {
+    size_t largestFitSize = 0;
+    int worstOffset = -1;
+
+    for (Hole hole : holes) {
+        if (hole.length >= sizeInWords && hole.length > largestFitSize) {
+            largestFitSize = hole.length;
+            worstOffset = static_cast<int>(hole.offset);
+        }
+    }
+
+    return worstOffset;
+}
+
+// Typed first fit: stops at the lowest-addressed hole that fits
+int FirstFitPolicy::place(size_t sizeInWords, const HoleView& holes) {
+    for (Hole hole : holes) {
+        if (hole.length >= sizeInWords) {
+            return static_cast<int>(hole.offset);
+        }
+    }
+
+    return -1;
+}
+
+// Typed next fit: searches from the cursor to the end, then from the start
+// up to the cursor
+int NextFitPolicy::place(size_t sizeInWords, const HoleView& holes) {
+    HoleView::const_iterator start = holes.lowerBound(cursor);
+    for (HoleView::const_iterator it = start; it != holes.end(); ++it) {
+        Hole hole = *it;
+        if (hole.length >= sizeInWords) {
+            cursor = hole.offset + sizeInWords;
+            return static_cast<int>(hole.offset);
+        }
+    }
+    for (HoleView::const_iterator it = holes.begin(); it != start; ++it) {
+        Hole hole = *it;
+        if (hole.length >= sizeInWords) {
+            cursor = hole.offset + sizeInWords;
+            return static_cast<int>(hole.offset);
+        }
+    }
+
+    return -1;
+}
+
+AdaptivePolicy::AdaptivePolicy(size_t smallClassWords, size_t windowSize, unsigned hysteresis)
+    : smallClassWords(smallClassWords), windowSize(windowSize ? windowSize : 1),
+      hysteresis(hysteresis ? hysteresis : 1), switchCount(0) {
+    candidates.push_back(Candidate{"bestFit", std::unique_ptr<PlacementPolicy>(new BestFitPolicy())});
+    candidates.push_back(Candidate{"worstFit", std::unique_ptr<PlacementPolicy>(new WorstFitPolicy())});
+    candidates.push_back(Candidate{"firstFit", std::unique_ptr<PlacementPolicy>(new FirstFitPolicy())});
+    candidates.push_back(Candidate{"nextFit", std::unique_ptr<PlacementPolicy>(new NextFitPolicy())});
+
+    // Both classes start on best fit, the safest single policy
+    small = SizeClass{0, 0, 0, 0, std::vector<double>(candidates.size(), 0.0)};
+    large = SizeClass{0, 0, 0, 0, std::vector<double>(candidates.size(), 0.0)};
+}
+
+int AdaptivePolicy::place(size_t sizeInWords, const HoleView& holes) {
+    return candidates[classFor(sizeInWords).active].policy->place(sizeInWords, holes);
+}
+
+void AdaptivePolicy::observe(size_t sizeInWords, bool placed, const HoleView& holes) {
+    SizeClass& sizeClass = classFor(sizeInWords);
+    ++sizeClass.requests;
+    if (!placed) {
+        ++sizeClass.failures;
+    }
+    if (sizeClass.requests >= windowSize) {
+        endWindow(sizeClass, holes);
+    }
+}
+
+const char* AdaptivePolicy::activePolicy(size_t sizeInWords) const {
+    const SizeClass& sizeClass = sizeInWords <= smallClassWords ? small : large;
+    return candidates[sizeClass.active].name;
+}
+
+size_t AdaptivePolicy::switches() const {
+    return switchCount;
+}
+
+AdaptivePolicy::SizeClass& AdaptivePolicy::classFor(size_t sizeInWords) {
+    return sizeInWords <= smallClassWords ? small : large;
+}
+
+// Scores the finished window against the active candidate. A window with
+// failed requests is bad; after `hysteresis` bad windows in a row the class
+// moves to the candidate with the lowest score. Fragmentation only weighs
+// into the score: it is arena-wide and would flap both classes on its own.
+void AdaptivePolicy::endWindow(SizeClass& sizeClass, const HoleView& holes) {
+    const double kFragmentationWeight = 0.1;
+    const double kSmoothing = 0.5;
+
+    size_t freeWords = 0;
+    size_t largestHole = 0;
+    for (Hole hole : holes) {
+        freeWords += hole.length;
+        largestHole = hole.length > largestHole ? hole.length : largestHole;
+    }
+    double fragmentation = freeWords ? 1.0 - static_cast<double>(largestHole) / freeWords : 0.0;
+    double failureRate = static_cast<double>(sizeClass.failures) / sizeClass.requests;
+
+    double& score = sizeClass.score[sizeClass.active];
+    score = kSmoothing * score + (1.0 - kSmoothing) * (failureRate + kFragmentationWeight * fragmentation);
+
+    sizeClass.badWindows = sizeClass.failures > 0 ? sizeClass.badWindows + 1 : 0;
+    sizeClass.requests = 0;
+    sizeClass.failures = 0;
+
+    if (sizeClass.badWindows < hysteresis) {
+        return;
+    }
+
+    // The active candidate just failed, so its score is above 0; untried
+    // candidates still score 0 and win, tried ones only if strictly better
+    size_t next = sizeClass.active;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (sizeClass.score[i] < sizeClass.score[next]) {
+            next = i;
+        }
+    }
+    if (next != sizeClass.active) {
+        sizeClass.active = next;
+        ++switchCount;
+    }
+    sizeClass.badWindows = 0;
+}
+
+CallbackPolicy::CallbackPolicy(std::function<int(int, void*)> allocator)
+    : allocator(allocator) {
+}
+
+// Materialises the hole index in the getList() layout and hands it to the callback
+int CallbackPolicy::place(size_t sizeInWords, const HoleView& holes) {
+    if (!allocator) {
+        return -1;
+    }
+
+    holeList.clear();
+    holeList.push_back(static_cast<uint16_t>(holes.size()));
+    for (Hole hole : holes) {
+        holeList.push_back(static_cast<uint16_t>(hole.offset));
+        holeList.push_back(static_cast<uint16_t>(hole.length));
+    }
+
+    return allocator(static_cast<int>(sizeInWords), holeList.data());
 }
 
 // Allocation strategy for finding the smallest available block
@@ -217,3 +2294,20 @@ int worstFit(int sizeInWords, void* list) {
 
     return worstOffset;
 }
+
+// Allocation strategy for finding the lowest-addressed available block
+int firstFit(int sizeInWords, void* list) {
+    uint16_t* holeList = static_cast<uint16_t*>(list);
+    uint16_t holeListLength = *holeList++;
+
+    for (uint16_t i = 0; i < holeListLength; ++i) {
+        uint16_t offset = holeList[2 * i];
+        uint16_t size = holeList[2 * i + 1];
+
+        if (size >= sizeInWords) { // holes are in address order, so the first fit wins
+            return offset;
+        }
+    }
+
+    return -1;
+}
@@ -2,32 +2,698 @@
 #define MEMORY_MANAGER_H
 
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <deque>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define MEMORY_MANAGER_COROUTINES 1
+#endif
+
+// A contiguous run of free words, in word units
+struct Hole {
+    size_t offset;
+    size_t length;
+};
+
+// Free runs as (offset, length) pairs sorted by offset in one contiguous
+// array, eight to a cache line. Lookups are binary searches and a policy's
+// scan is a linear walk, where a node-based map chases a pointer per hole.
+// Inserts and erases move the tail, a short memmove for the hole counts an
+// arena of at most 65536 words produces. The interface is the subset of
+// std::map the allocator uses.
+class HoleIndex {
+public:
+    typedef std::pair<uint32_t, uint32_t> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    iterator begin() { return runs.begin(); }
+    iterator end() { return runs.end(); }
+    const_iterator begin() const { return runs.begin(); }
+    const_iterator end() const { return runs.end(); }
+    size_t size() const { return runs.size(); }
+    bool empty() const { return runs.empty(); }
+    void clear() { runs.clear(); }
+
+    iterator lower_bound(size_t offset) { // First hole at or after offset
+        return std::lower_bound(runs.begin(), runs.end(), offset, startsBefore);
+    }
+    const_iterator lower_bound(size_t offset) const {
+        return std::lower_bound(runs.begin(), runs.end(), offset, startsBefore);
+    }
+    iterator upper_bound(size_t offset) { // First hole after offset
+        return std::upper_bound(runs.begin(), runs.end(), offset, startsAfter);
+    }
+    const_iterator upper_bound(size_t offset) const {
+        return std::upper_bound(runs.begin(), runs.end(), offset, startsAfter);
+    }
+    iterator insert(iterator position, size_t offset, size_t length) { // position must keep the order
+        return runs.insert(position, value_type(offset, length));
+    }
+    iterator erase(iterator position) { return runs.erase(position); }
+    uint32_t& operator[](size_t offset) { // Length of the hole at offset, inserting an empty one if needed
+        iterator it = lower_bound(offset);
+        if (it == runs.end() || it->first != offset) {
+            it = runs.insert(it, value_type(offset, 0));
+        }
+        return it->second;
+    }
+
+private:
+    static bool startsBefore(const value_type& run, size_t offset) { return run.first < offset; }
+    static bool startsAfter(size_t offset, const value_type& run) { return offset < run.first; }
+
+    std::vector<value_type> runs;
+};
+
+// Read-only view over the live hole index, ordered by offset. Iterating it
+// never allocates, so placement policies can walk it on every allocate().
+// A view may be limited to the holes that start in [first, last). Each step
+// prefetches a few cache lines ahead so long scans do not stall on misses.
+class HoleView {
+public:
+    class const_iterator {
+    public:
+        explicit const_iterator(HoleIndex::const_iterator it) : it(it) {}
+        Hole operator*() const { return Hole{it->first, it->second}; }
+        const_iterator& operator++() {
+            __builtin_prefetch(reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(&*it) + kPrefetchBytes));
+            ++it;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return it == other.it; }
+        bool operator!=(const const_iterator& other) const { return it != other.it; }
+
+    private:
+        static const size_t kPrefetchBytes = 4 * 64;
+        HoleIndex::const_iterator it;
+    };
+
+    explicit HoleView(const HoleIndex& holes, size_t first = 0, size_t last = SIZE_MAX)
+        : holes(holes), first(first), last(last) {}
+    const_iterator begin() const { return const_iterator(holes.lower_bound(first)); }
+    const_iterator end() const { return const_iterator(holes.lower_bound(last)); }
+    const_iterator lowerBound(size_t offset) const { // First hole at or after offset
+        return const_iterator(holes.lower_bound(offset < first ? first : offset > last ? last : offset));
+    }
+    size_t size() const { // Number of holes
+        return first == 0 && last == SIZE_MAX ? holes.size()
+            : std::distance(holes.lower_bound(first), holes.lower_bound(last));
+    }
+    bool empty() const { return begin() == end(); }
+
+private:
+    const HoleIndex& holes;
+    size_t first;
+    size_t last;
+};
+
+// Placement strategy: picks the word offset of a hole that can hold
+// sizeInWords, or returns -1. Implementations may stop iterating early.
+// observe() is called after every allocate() with the outcome and the
+// updated holes, for policies that learn from the workload.
+class PlacementPolicy {
+public:
+    virtual ~PlacementPolicy() = default;
+    virtual int place(size_t sizeInWords, const HoleView& holes) = 0;
+    virtual void observe(size_t sizeInWords, bool placed, const HoleView& holes) {
+        (void)sizeInWords; (void)placed; (void)holes;
+    }
+};
+
+// Smallest hole that fits
+class BestFitPolicy : public PlacementPolicy {
+public:
+    int place(size_t sizeInWords, const HoleView& holes) override;
+};
+
+// Largest hole that fits
+class WorstFitPolicy : public PlacementPolicy {
+public:
+    int place(size_t sizeInWords, const HoleView& holes) override;
+};
+
+// Lowest-addressed hole that fits
+class FirstFitPolicy : public PlacementPolicy {
+public:
+    int place(size_t sizeInWords, const HoleView& holes) override;
+};
+
+// First hole that fits at or after a roving cursor, wrapping around once.
+// The cursor moves past each placement so successive allocations do not
+// rescan the densely allocated start of the arena.
+class NextFitPolicy : public PlacementPolicy {
+public:
+    NextFitPolicy() : cursor(0) {}
+    int place(size_t sizeInWords, const HoleView& holes) override;
+
+private:
+    size_t cursor; // word offset the next search starts from
+};
+
+// Switches between the stock policies by workload. Requests are split into a
+// small and a large size class, each with its own active policy. Every
+// windowSize requests a class scores its window on failure rate and
+// fragmentation (1 - largest hole / free words); after `hysteresis`
+// consecutive windows with failures it moves to the best-scoring candidate.
+class AdaptivePolicy : public PlacementPolicy {
+public:
+    explicit AdaptivePolicy(size_t smallClassWords = 32, size_t windowSize = 32, unsigned hysteresis = 2);
+    int place(size_t sizeInWords, const HoleView& holes) override;
+    void observe(size_t sizeInWords, bool placed, const HoleView& holes) override;
+    const char* activePolicy(size_t sizeInWords) const; // Name of the policy serving this size
+    size_t switches() const; // Number of policy changes so far
+
+private:
+    struct Candidate {
+        const char* name;
+        std::unique_ptr<PlacementPolicy> policy;
+    };
+    struct SizeClass {
+        size_t active; // index into candidates
+        size_t requests; // requests in the current window
+        size_t failures; // failed requests in the current window
+        unsigned badWindows; // consecutive windows with failures
+        std::vector<double> score; // smoothed badness per candidate, lower is better
+    };
+
+    SizeClass& classFor(size_t sizeInWords);
+    void endWindow(SizeClass& sizeClass, const HoleView& holes);
+
+    size_t smallClassWords;
+    size_t windowSize;
+    unsigned hysteresis;
+    size_t switchCount;
+    std::vector<Candidate> candidates;
+    SizeClass small;
+    SizeClass large;
+};
+
+// Adapter for int(int, void*) allocators that expect the getList() layout:
+// [holeCount, offset0, length0, offset1, length1, ...] as uint16_t. The list
+// buffer is reused between calls.
+class CallbackPolicy : public PlacementPolicy {
+public:
+    explicit CallbackPolicy(std::function<int(int, void*)> allocator);
+    int place(size_t sizeInWords, const HoleView& holes) override;
+
+private:
+    std::function<int(int, void*)> allocator;
+    std::vector<uint16_t> holeList;
+};
+
+// How initialize() carves up the arena
+enum class AllocationMode {
+    Placement, // any hole, chosen by the PlacementPolicy
+    Buddy // binary buddy system, blocks rounded up to a power of two words
+};
+
+// Arena setup for initialize()
+struct InitOptions {
+    AllocationMode mode = AllocationMode::Placement;
+    bool numa = false; // one partition per NUMA node, allocate() prefers the caller's node; placement mode only
+    size_t numaNodes = 0; // partitions to create in NUMA mode; 0 uses the machine's node count
+    const char* sharedName = nullptr; // POSIX shared-memory name ("/name") to create the arena in; placement mode only
+    bool prefault = false; // populate the arena's pages up front (MAP_POPULATE, MADV_WILLNEED) instead of on first touch
+    unsigned zeroThreads = 0; // zero the arena across this many threads at startup, touching every page; 0 skips it
+};
+
+// Layout of a shared arena segment, defined in MemoryManager.cpp
+struct SharedArenaHeader;
+
+// Per-partition usage in NUMA mode, in words
+struct NodeStats {
+    size_t totalWords;
+    size_t usedWords;
+    size_t localAllocations; // placed on the caller's node
+    size_t remoteAllocations; // placed here after the caller's node was full
+};
+
+// Faults caught in hardened mode
+enum class Violation {
+    GuardCorrupted, // a canary word next to a block was overwritten
+    DoubleFree, // free of a word that is not allocated
+    InvalidFree // free of a pointer that is not the start of a block
+};
+
+// Hardened mode for canary hosts. Double and invalid frees are caught on
+// every free through the block-start table. One allocation in sampleRate
+// also gets guardWords of canary on each side, checked when it is freed,
+// and has its memory poisoned on free. The lock-free small class is not
+// guarded, but its double frees are caught.
+struct HardeningOptions {
+    bool enabled = false;
+    size_t guardWords = 1; // canary words before and after a sampled block; 0 samples nothing
+    bool poison = true; // fill sampled blocks with a pattern when freed
+    unsigned sampleRate = 1; // 1 guards every allocation, 0 none
+    std::function<void(Violation, size_t offset)> onViolation; // runs with the lock held; must not call back in
+};
+
+// Used words against the soft limits set by setWatermarks()
+enum class Pressure {
+    Normal, // below the low watermark
+    Low, // at or above the low watermark
+    High // at or above the high watermark
+};
+
+// A live allocation picked by the heap profiler
+struct HeapSample {
+    size_t sizeInBytes; // as requested
+    size_t offset; // word offset of the block
+    std::vector<void*> stack; // return addresses, innermost first
+};
+
+// Bitmap of one changed chunk, in the getBitmap() layout without the length prefix
+struct BitmapChunk {
+    size_t firstWord;
+    size_t words;
+    std::vector<uint8_t> bitmap;
+};
+
+// Chunks whose allocation bits may have changed since an epoch
+struct BitmapDelta {
+    uint64_t epoch; // pass to the next call
+    std::vector<BitmapChunk> chunks;
+};
+
+// Holes that may have changed since an epoch. A hole is listed when its
+// first or last word lies in a changed chunk; to update a copy of getList(),
+// drop the holes that start or end in one of those chunks and add these.
+struct ListDelta {
+    uint64_t epoch; // pass to the next call
+    size_t chunkWords;
+    std::vector<size_t> chunks; // indices of the changed chunks
+    std::vector<Hole> holes;
+};
+
+// Snapshot of arena usage, in words
+struct MemoryStats {
+    size_t totalWords;
+    size_t usedWords; // words held by live blocks
+    size_t requestedWords; // words asked for by live blocks; below usedWords in buddy mode
+    size_t freeWords;
+    size_t holeCount;
+    size_t largestHole;
+    size_t allocations; // successful allocate() calls
+    size_t failedAllocations;
+    size_t frees;
+    size_t pendingFrees; // deferred frees not yet drained
+    size_t waitingAllocations; // allocateAsync() requests parked until a free makes room
+    size_t smallClassSlots; // slots in the lock-free small class region
+    size_t smallClassSlotsInUse;
+    std::vector<NodeStats> nodes; // one entry per partition; a single entry outside NUMA mode
+    size_t hardenedAllocations; // allocations given guard words in hardened mode
+    size_t guardViolations;
+    size_t doubleFrees;
+    size_t invalidFrees;
+    size_t zeroFillSkippedWords; // words allocateZeroed() handed out without clearing, known to be still zero
+    Pressure pressure; // where usedWords stands against the watermarks
+    size_t reclaimPasses; // reclaim hook passes run for an allocate() that did not fit
+    size_t reclaimedAllocations; // allocations that only fit after a reclaim pass
+    double internalFragmentation; // 1 - requestedWords / usedWords
+    double externalFragmentation; // 1 - largestHole / freeWords
+};
+
+class AllocationAwaitable;
 
 class MemoryManager {
 public:
     MemoryManager(unsigned int wordSize, std::function<int(int, void*)> allocator); // Constructor
+    MemoryManager(unsigned int wordSize, std::unique_ptr<PlacementPolicy> policy); // Constructor with a typed policy
     ~MemoryManager(); // Destructor
-    void initialize(size_t numberOfWords); // Initializes memory
+    void initialize(size_t numberOfWords, AllocationMode mode = AllocationMode::Placement); // Initializes memory
+    void initialize(size_t numberOfWords, const InitOptions& options); // Initializes memory with placement options
+    bool attach(const char* sharedName); // Maps an arena another process created with InitOptions::sharedName
+    bool initializeFromFile(const char* path, size_t numberOfWords); // Maps a file as a persistent arena, reopening it if it holds one
     void shutdown(); // Shuts down and releases memory
     void* allocate(size_t sizeInBytes); // Allocates a block of memory
+    void* allocateZeroed(size_t sizeInBytes); // Allocates a block whose first sizeInBytes bytes are zero
+    void* allocateAligned(size_t sizeInBytes, size_t alignment); // Allocates a block at a multiple of alignment, a power of two
     void free(void* address); // Frees a previously allocated block
+    int allocateOffset(size_t sizeInBytes); // Allocates a block, returns its word offset from getMemoryStart() or -1
+    void freeOffset(size_t offset); // Frees the block at a word offset returned by allocateOffset()
     void setAllocator(std::function<int(int, void*)> allocator); // Sets the allocation strategy
+    void setPlacementPolicy(std::unique_ptr<PlacementPolicy> policy); // Sets a typed allocation strategy
     int dumpMemoryMap(char* filename); // Dumps memory map to a file
     unsigned getWordSize(); // Gets the word size
     unsigned getMemoryLimit(); // Gets the memory limit
     void* getMemoryStart(); // Gets the starting address of memory
     void* getBitmap(); // Returns bitmap of allocated memory
-    void* getList(); // Placeholder for getting the list of memory holes
+    void* getList(); // Returns the list of memory holes
+    HoleView getHoles() const; // Returns a view over the live hole index; not safe against concurrent allocate/free
+    MemoryStats getStats() const; // Returns usage and fragmentation counters; for a shared arena, as of this process's last call
+
+    // Shared arenas: the status bytes live in the segment next to the data
+    // and are guarded by a robust process-shared mutex. Each process keeps its
+    // own hole index and reloads it from the status bytes whenever another
+    // process has changed them. Allocation counters are per process, and the
+    // lock-free small class is not available. Blocks are exchanged between
+    // processes as offsets from getMemoryStart(). A file-backed arena uses the
+    // same layout in a MAP_SHARED file mapping and is msync'd on shutdown().
+
+    // Deferred free: free() only queues the block on a lock-free list, and
+    // maintain(), the maintenance thread or an allocate() that would
+    // otherwise fail releases queued blocks in address order
+    void setDeferredFree(bool enabled); // Turns deferred free on or off; turning it off drains the queue
+    size_t maintain(); // Releases queued frees, returns how many blocks were released
+    void startMaintenanceThread(std::chrono::milliseconds interval); // Runs maintain() in the background
+    void stopMaintenanceThread(); // Stops and joins the maintenance thread
+
+    // Async allocation: a request that does not fit, or that would overtake
+    // requests already waiting, is parked in a queue per size class (words
+    // rounded up to a power of two) instead of failing. Each free() hands the
+    // space it opens to the waiters, smallest class first and in arrival
+    // order within a class. The callback runs exactly once and without the
+    // lock held, on the caller's thread if the block is available at once,
+    // otherwise on the thread whose free() made room. It gets nullptr if the
+    // request can never fit or the arena is shut down or reinitialized first.
+    void allocateAsync(size_t sizeInBytes, std::function<void(void*)> callback);
+#ifdef MEMORY_MANAGER_COROUTINES
+    AllocationAwaitable allocateAsync(size_t sizeInBytes); // co_await form, resumes with the block or nullptr
+#endif
+
+    // Lock-free small class: reserves slotCount slots of sizeInBytes as one
+    // region of the arena. Requests up to sizeInBytes then claim a slot with a
+    // CAS on an atomic occupancy bitmap and never take the lock; free() clears
+    // the bit. The region is one block in getList() and shows per slot in
+    // getBitmap(). Returns false if there is no room or a class already exists.
+    bool enableSmallClass(size_t sizeInBytes, size_t slotCount);
+
+    void setHardening(const HardeningOptions& options); // Turns hardened mode on or off
+
+    // Heap profiler: on average one allocation per sampleBytes allocated
+    // records its backtrace, size and offset in a side table until it is
+    // freed. Sample points are drawn from an exponential distribution, as
+    // pprof's heap_v2 unsampling expects. Small class slots are not sampled:
+    // the region is one fixed block and does not fragment the arena. Neither
+    // are async requests served by a later free, which runs on the freeing
+    // thread's stack.
+    void startProfiling(size_t sampleBytes = 512 * 1024); // Clears the table and starts sampling
+    void stopProfiling(); // Stops sampling and drops the table
+    std::vector<HeapSample> getHeapSamples() const; // Live sampled allocations, by offset
+    int dumpHeapProfile(const char* filename) const; // Writes the live samples in pprof's legacy heap format
+
+    // Change tracking: allocate() and free() stamp the 512-word chunks they
+    // touch with a rising epoch, so a monitor can fetch only what changed
+    // since its last call. The first call after enabling, or with epoch 0,
+    // returns everything.
+    void setChangeTracking(bool enabled); // Turns change tracking on or off
+    BitmapDelta getBitmapDelta(uint64_t sinceEpoch); // Bitmaps of the chunks changed after sinceEpoch
+    ListDelta getListDelta(uint64_t sinceEpoch); // Holes touching the chunks changed after sinceEpoch
+
+    // Soft limits: the pressure level follows usedWords as blocks are
+    // allocated and freed, and every change of level calls the pressure
+    // callbacks so an owner such as a cache can evict before the arena runs
+    // out. An allocate() that does not fit runs the reclaim hooks, in
+    // registration order until they report enough words freed, and then
+    // retries once. Callbacks and hooks run without the lock held and may
+    // free; a watermark of 0 is off.
+    void setWatermarks(size_t lowWords, size_t highWords); // Sets the soft limits, in used words
+    size_t addPressureCallback(std::function<void(Pressure, size_t usedWords)> callback); // Returns an id for removeHook()
+    size_t addReclaimHook(std::function<size_t(size_t wordsNeeded)> hook); // Hook returns the words it freed
+    void removeHook(size_t id); // Unregisters a pressure callback or reclaim hook
 
 private:
+    class ArenaLock; // Holds mutex and, for a shared arena, the segment lock
+
+    void resetMetadata(size_t sizeInWords); // Clears every hole, block and queue for a fresh arena
+    bool createShared(const char* name, size_t sizeInWords); // Creates and maps a fresh shared segment
+    void adoptSegment(void* mapping, size_t bytes); // Uses a mapped, validated segment as the arena
+    void mirrorShared(size_t offset, size_t words); // Copies changed status bytes into the segment
+    void releaseArena(); // Frees or unmaps memoryStart
+    void lockShared(); // Takes the segment lock and reloads if another process changed the arena; caller holds mutex
+    void unlockShared(); // Publishes this process's changes and releases the segment lock
+    void reloadShared(); // Rebuilds the status bytes, holes and usage from the segment
+    void bindPartitions(); // Places each NUMA partition's pages on its node
+    size_t callerNode() const; // Partition of the NUMA node the calling thread runs on
+    void* allocateSmall(); // Claims a small class slot, or returns nullptr when they are all taken
+    bool freeSmall(void* address); // Releases a small class slot; false if address is outside the region
+    int allocateBlock(size_t sizeInBytes, size_t alignment, const void* caller); // allocateOffset() at a multiple of alignment, 0 for any word
+    bool wordAligned(size_t alignment) const; // Every word address is a multiple of alignment
+    int placeBlock(size_t wordsNeeded, size_t alignment = 0); // Picks and claims words for a block, returns its offset or -1
+    bool releaseBlock(size_t offset); // Releases the block starting at offset, if there is one
+    bool checkFree(size_t& offset); // Validates a free, moving a guarded block's offset back to its start
+    void armBlock(size_t offset, size_t words, size_t guardWords); // Writes canaries around a sampled block
+    void reportViolation(Violation violation, size_t offset); // Counts a violation and calls the handler
+    void recordSample(size_t offset, size_t sizeInBytes, const void* caller); // Adds a profiler sample if this allocation is due one
+    size_t blockLength(size_t offset) const; // Words in the placement-mode block starting at offset
+    void pushDeferred(size_t offset); // Queues a free without taking the lock
+    size_t drainDeferred(); // Releases every queued free, returns how many were live blocks; caller holds the lock
+    void maintenanceLoop(std::chrono::milliseconds interval); // Body of the maintenance thread
+    struct AsyncWaiter {
+        size_t sizeInBytes;
+        std::function<void(void*)> callback;
+    };
+    typedef std::vector<std::pair<std::function<void(void*)>, void*>> WokenWaiters; // Callbacks to run once unlocked
+    int allocateLocked(size_t sizeInBytes, size_t alignment, const void* caller, WokenWaiters* woken); // allocateBlock() past the small class; caller holds the lock
+    void serveWaiters(WokenWaiters& woken); // Places queued async requests that now fit; caller holds the lock
+    void runWaiters(WokenWaiters& woken); // Calls the served requests back; caller does not hold the lock
+    void cancelWaiters(); // Fails every queued async request; takes the lock itself
+    size_t guardOverhead() const; // Guard words a sampled block adds in hardened mode
+    size_t largestPlaceable() const; // Biggest block the arena could ever place, in words; caller holds the lock
+    bool fitsNow(size_t wordsNeeded) const; // A block of wordsNeeded, guards included, can be placed now; caller holds the lock
+    struct PressureChange {
+        bool changed;
+        Pressure pressure;
+        size_t usedWords;
+    };
+    PressureChange updatePressure(); // Recomputes the pressure level; caller holds the lock
+    void notifyPressure(const PressureChange& change); // Runs the pressure callbacks if the level changed; caller does not hold the lock
+    void runReclaimHooks(size_t wordsNeeded); // One reclaim pass; caller does not hold the lock
+    int placeBuddy(size_t wordsNeeded); // Finds and splits a buddy block, returns its offset or -1
+    void freeBuddy(size_t offset); // Releases a buddy block and merges it with free buddies
+    void markAllocated(size_t offset, size_t words, uint8_t order = 0); // Claims words and splits the hole they came from
+    void markFree(size_t offset, size_t words); // Releases words and merges neighbouring holes
+    void markChanged(size_t firstWord, size_t lastWord); // Stamps the chunks holding [firstWord, lastWord]
+    uint64_t deltaEpoch(uint64_t sinceEpoch) const; // Epoch a delta taken now covers, sinceEpoch while a stamp is pending
+    void resetChangeTracking(size_t sizeInWords); // Sizes the chunk stamps and marks every chunk changed
+    void fillBitmap(size_t firstWord, size_t words, uint8_t* bitmap) const; // Writes allocation bits for a word range
+
     unsigned int wordSize; // Size of each word
     unsigned int memoryLimit; // Limit of memory in bytes
     char* memoryStart; // Starting address of memory
-    std::function<int(int, void*)> allocator; // Function pointer to allocation strategy
-    std::vector<uint8_t> allocationStatus;
+    std::unique_ptr<PlacementPolicy> policy; // Allocation strategy
+    std::vector<uint8_t> allocationStatus; // Per-word status flags
+    HoleIndex holes; // Free runs, offset -> length
+    std::vector<uint64_t> allocatedBits; // Hot copy of kAllocated, one bit per word, for block scans
+    std::vector<uint64_t> blockStartBits; // Hot copy of kBlockStart
+    std::vector<uint64_t> dirtyBits; // Words that may be nonzero: freed since the arena was zeroed, or never known zero
+    AllocationMode mode; // Chosen at initialize()
+    std::vector<std::set<size_t>> buddyFreeLists; // Free block offsets per order, buddy mode only
+    std::unordered_map<size_t, size_t> buddyRequested; // Live block offset -> words requested, buddy mode only
+    size_t usedWords; // Words in live blocks
+    size_t requestedWords; // Words requested by live blocks
+    size_t allocationCount; // Successful allocations
+    size_t failedAllocationCount; // Failed allocations
+    size_t freeCount; // Successful frees
+
+    mutable std::mutex mutex; // Guards everything above
+    std::atomic<bool> deferredFree; // free() queues instead of releasing
+    std::unique_ptr<std::atomic<uint32_t>[]> deferredNext; // Per-word link of the deferred free list
+    std::atomic<uint32_t> deferredHead; // Most recently queued offset
+    std::atomic<size_t> deferredPending; // Queued frees not yet drained
+    std::thread maintenanceThread;
+    std::condition_variable maintenanceWake;
+    bool maintenanceStop; // Guarded by mutex
+    std::vector<uint32_t> drainBatch; // Reused buffer for sorting a drained batch
+    std::map<uint8_t, std::deque<AsyncWaiter>> asyncWaiters; // Size class -> parked requests in arrival order
+    std::atomic<size_t> asyncWaiting; // Parked requests, plus any being placed; read by deferred free without the lock
+
+    std::atomic<size_t> smallClassSlotWords; // Words per slot, 0 when there is no small class
+    size_t smallClassOffset; // First word of the region
+    size_t smallClassSlotCount;
+    size_t smallClassBitmapWords; // Entries in smallClassBits
+    std::unique_ptr<std::atomic<uint64_t>[]> smallClassBits; // Bit set = slot in use
+
+    bool arenaMapped; // memoryStart came from mmap rather than new[]
+    size_t partitionWords; // Words per NUMA partition; holes never cross a partition boundary
+    std::vector<NodeStats> nodeStats; // Per partition
+    std::vector<size_t> cpuNode; // CPU number -> NUMA node
+
+    SharedArenaHeader* sharedHeader; // Start of the shared segment, nullptr for a private arena
+    uint8_t* sharedStatus; // Status bytes in the segment, mirrored by allocationStatus
+    size_t sharedBytes; // Mapped size of the segment
+    std::string sharedName;
+    bool sharedOwner; // This process created the segment and unlinks it on shutdown
+    int sharedFileFd; // Locked file descriptor of an initializeFromFile() segment, -1 otherwise
+    uint64_t sharedGeneration; // Segment generation allocationStatus was last synced with
+    bool sharedDirty; // Status bytes changed under the current segment lock
+
+    HardeningOptions hardening; // Guarded by mutex
+    size_t hardeningSequence; // Allocations seen, for sampling
+    size_t hardenedAllocationCount;
+    size_t guardViolationCount;
+    size_t doubleFreeCount;
+    size_t invalidFreeCount;
+    size_t zeroFillSkippedCount; // Words allocateZeroed() did not have to clear
+
+    size_t lowWatermark; // Used words, 0 when off
+    size_t highWatermark;
+    Pressure pressure; // Level as of the last allocate or free
+    size_t nextHookId;
+    std::vector<std::pair<size_t, std::function<void(Pressure, size_t)>>> pressureCallbacks; // Id -> callback
+    std::vector<std::pair<size_t, std::function<size_t(size_t)>>> reclaimHooks; // Id -> hook, in registration order
+    size_t reclaimPassCount;
+    size_t reclaimedAllocationCount;
+
+    size_t profileSampleBytes; // Mean bytes between samples, 0 when not profiling
+    size_t profileCountdown; // Bytes left until the next sample
+    std::mt19937_64 profileRandom;
+    std::map<size_t, HeapSample> heapSamples; // Block offset -> sample
+
+    std::atomic<bool> changeTracking;
+    std::atomic<uint64_t> changeEpoch; // Last epoch handed out
+    std::atomic<unsigned> changeStampers; // markChanged calls holding an epoch they have not stamped yet
+    std::unique_ptr<std::atomic<uint64_t>[]> chunkEpochs; // Per chunk, epoch of its last change; kept while tracking is off
+    size_t chunkCount;
 
 };
 
+// Typed word offset into an arena. It holds no address, so structures linked
+// with OffsetPtr stay valid when the arena is copied, snapshotted or mapped
+// at another address; resolve it against the arena it is used with.
+template <typename T>
+class OffsetPtr {
+public:
+    OffsetPtr() : offset(-1) {}
+    explicit OffsetPtr(int offset) : offset(offset < 0 ? -1 : offset) {}
+
+    // Allocates room for count objects; a null OffsetPtr if that fails
+    static OffsetPtr allocate(MemoryManager& memoryManager, size_t count = 1) {
+        return OffsetPtr(memoryManager.allocateOffset(sizeof(T) * count));
+    }
+    void free(MemoryManager& memoryManager) { // Frees the block and nulls this pointer
+        if (offset >= 0) {
+            memoryManager.freeOffset(offset);
+        }
+        offset = -1;
+    }
+
+    T* get(MemoryManager& memoryManager) const { // Address in memoryManager's arena
+        return get(memoryManager.getMemoryStart(), memoryManager.getWordSize());
+    }
+    T* get(void* memoryStart, unsigned wordSize) const { // Address in a copy of the arena
+        return offset < 0 ? nullptr : reinterpret_cast<T*>(static_cast<char*>(memoryStart) + size_t(offset) * wordSize);
+    }
+
+    int wordOffset() const { return offset; }
+    explicit operator bool() const { return offset >= 0; }
+    bool operator==(const OffsetPtr& other) const { return offset == other.offset; }
+    bool operator!=(const OffsetPtr& other) const { return offset != other.offset; }
+
+private:
+    int32_t offset; // -1 is null
+};
+
+// std::pmr bridge: containers built on this resource keep their storage in
+// the arena. A failed allocation throws std::bad_alloc as the interface
+// requires. Two resources are equal when they share a manager, so memory
+// from one may be returned through the other.
+class MemoryManagerResource : public std::pmr::memory_resource {
+public:
+    explicit MemoryManagerResource(MemoryManager& memoryManager) : memoryManager(memoryManager) {}
+    MemoryManager& manager() const { return memoryManager; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void* block = memoryManager.allocateAligned(bytes ? bytes : 1, alignment);
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        return block;
+    }
+    void do_deallocate(void* block, std::size_t, std::size_t) override { memoryManager.free(block); }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        const MemoryManagerResource* resource = dynamic_cast<const MemoryManagerResource*>(&other);
+        return resource != nullptr && &resource->memoryManager == &memoryManager;
+    }
+
+    MemoryManager& memoryManager;
+};
+
+// Typed allocator for standard containers outside std::pmr, e.g.
+// std::vector<int, ArenaAllocator<int>> v(ArenaAllocator<int>(memoryManager))
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(MemoryManager& memoryManager) : memoryManager(&memoryManager) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : memoryManager(&other.manager()) {}
+
+    T* allocate(std::size_t count) {
+        void* block = count <= SIZE_MAX / sizeof(T)
+            ? memoryManager->allocateAligned(count ? sizeof(T) * count : 1, alignof(T))
+            : nullptr;
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(block);
+    }
+    void deallocate(T* block, std::size_t) { memoryManager->free(block); }
+
+    MemoryManager& manager() const { return *memoryManager; }
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return memoryManager == &other.manager(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return memoryManager != &other.manager(); }
+
+private:
+    MemoryManager* memoryManager;
+};
+
+#ifdef MEMORY_MANAGER_COROUTINES
+// Result of co_await memoryManager.allocateAsync(n). The request is queued
+// on suspension; whichever of the callback and await_suspend() finishes
+// second decides how the coroutine continues, so it is resumed exactly once
+// whether the block arrives at once, later on a freeing thread, or never.
+class AllocationAwaitable {
+public:
+    AllocationAwaitable(MemoryManager& memoryManager, size_t sizeInBytes)
+        : memoryManager(memoryManager), sizeInBytes(sizeInBytes), block(nullptr), handedOff(false) {}
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        this->handle = handle;
+        memoryManager.allocateAsync(sizeInBytes, [this](void* result) {
+            block = result;
+            if (handedOff.exchange(true)) {
+                this->handle.resume();
+            }
+        });
+        return !handedOff.exchange(true); // false: the block is already here, carry on
+    }
+    void* await_resume() const noexcept { return block; }
+
+private:
+    MemoryManager& memoryManager;
+    size_t sizeInBytes;
+    void* block;
+    std::atomic<bool> handedOff;
+    std::coroutine_handle<> handle;
+};
+
+inline AllocationAwaitable MemoryManager::allocateAsync(size_t sizeInBytes) {
+    return AllocationAwaitable(*this, sizeInBytes);
+}
+#endif
+
 #endif // MEMORY_MANAGER_H
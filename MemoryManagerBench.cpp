@@ -0,0 +1,398 @@
+#include "MemoryManager.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Trace-driven placement benchmark. Each workload is a fixed, seeded
+// sequence of allocate/free events replayed against every policy on a fresh
+// arena; we report failed allocations, internal and external fragmentation
+// at the end of the trace and time per operation.
+//
+// A second section measures small-allocation throughput under contention,
+// through the mutex and through the lock-free small class. The last two
+// measure the cost of hardened mode and of the heap profiler at several
+// sample rates. Then come the startup of a large arena with and without
+// prefaulting and parallel zeroing, and insert-heavy std::pmr containers on
+// the arena against the default heap.
+//
+// `MemoryManagerBench replay` only replays the traces, best fit, several
+// times over and prints the operation count; `make perfstat` runs it under
+// perf stat to report cache misses per allocate/free.
+
+struct Event {
+    bool isAllocate;
+    size_t id; // slot the block is stored in
+    size_t sizeInWords; // only for allocations
+};
+
+struct Workload {
+    std::string name;
+    size_t arenaWords;
+    std::vector<Event> events;
+};
+
+// Small deterministic generator so traces are identical across runs
+class Lcg {
+public:
+    explicit Lcg(uint64_t seed) : state(seed) {}
+    size_t next(size_t bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<size_t>((state >> 33) % bound);
+    }
+
+private:
+    uint64_t state;
+};
+
+// Builds a trace that keeps a pool of `live` blocks, replacing a random one on each step
+void churn(Workload& workload, Lcg& rng, std::vector<size_t>& live, size_t& nextId,
+           size_t steps, size_t minWords, size_t maxWords, size_t poolSize) {
+    for (size_t step = 0; step < steps; ++step) {
+        if (live.size() >= poolSize) {
+            size_t victim = rng.next(live.size());
+            workload.events.push_back(Event{false, live[victim], 0});
+            live[victim] = live.back();
+            live.pop_back();
+        }
+        size_t sizeInWords = minWords + rng.next(maxWords - minWords + 1);
+        workload.events.push_back(Event{true, nextId, sizeInWords});
+        live.push_back(nextId++);
+    }
+}
+
+// Frees every block in `live`
+void drain(Workload& workload, std::vector<size_t>& live) {
+    for (size_t id : live) {
+        workload.events.push_back(Event{false, id, 0});
+    }
+    live.clear();
+}
+
+Workload smallBursts() {
+    Workload workload{"small-bursts", 16384, {}};
+    Lcg rng(1);
+    std::vector<size_t> live;
+    size_t nextId = 0;
+    churn(workload, rng, live, nextId, 60000, 1, 8, 3000);
+    return workload;
+}
+
+Workload largeBuffers() {
+    Workload workload{"large-buffers", 16384, {}};
+    Lcg rng(2);
+    std::vector<size_t> live;
+    size_t nextId = 0;
+    churn(workload, rng, live, nextId, 20000, 256, 2048, 14);
+    return workload;
+}
+
+// A nearly full arena: pinned descriptors split it into 80-word object pages
+// plus one 144-word and one 240-word frame slot. Phases of small-object churn
+// (best fit packs the pages, worst fit strands them) alternate with frames
+// recycled header-first as 96 + 144 + 144 words (best fit drops the header in
+// the 144 slot and cannot place the second payload, worst fit can).
+Workload frameSlots() {
+    Workload workload{"frame-slots", 16384, {}};
+    Lcg rng(11);
+    size_t nextId = 0;
+    auto allocate = [&](size_t sizeInWords) {
+        workload.events.push_back(Event{true, nextId, sizeInWords});
+        return nextId++;
+    };
+
+    std::vector<size_t> layout;
+    size_t used = 0;
+    while (used + 81 < workload.arenaWords - 144 - 240 - 3) {
+        layout.push_back(allocate(80));
+        allocate(1);
+        used += 81;
+    }
+    layout.push_back(allocate(144));
+    allocate(1);
+    layout.push_back(allocate(240));
+    allocate(1);
+    allocate(workload.arenaWords - used - 144 - 240 - 2);
+    drain(workload, layout);
+
+    std::vector<size_t> objects;
+    for (int phase = 0; phase < 20; ++phase) {
+        churn(workload, rng, objects, nextId, 3000, 1, 32, 700);
+        drain(workload, objects);
+        for (int round = 0; round < 50; ++round) {
+            std::vector<size_t> frame{allocate(96), allocate(144), allocate(144)};
+            drain(workload, frame);
+        }
+    }
+    return workload;
+}
+
+// Power-of-two buffers with a few odd sizes mixed in
+Workload powerOfTwoBuffers() {
+    Workload workload{"pow2-buffers", 16384, {}};
+    Lcg rng(4);
+    size_t nextId = 0;
+    std::vector<size_t> live;
+    for (size_t step = 0; step < 40000; ++step) {
+        if (live.size() >= 120) {
+            size_t victim = rng.next(live.size());
+            workload.events.push_back(Event{false, live[victim], 0});
+            live[victim] = live.back();
+            live.pop_back();
+        }
+        size_t sizeInWords = size_t(1) << rng.next(9);
+        if (rng.next(10) == 0) {
+            sizeInWords += rng.next(sizeInWords);
+        }
+        workload.events.push_back(Event{true, nextId, sizeInWords});
+        live.push_back(nextId++);
+    }
+    return workload;
+}
+
+struct Result {
+    size_t failures;
+    double internalFragmentation;
+    double externalFragmentation;
+    double nsPerOp;
+};
+
+Result replay(const Workload& workload, std::unique_ptr<PlacementPolicy> policy, AllocationMode mode,
+              const HardeningOptions& hardening = HardeningOptions(), size_t profileSampleBytes = 0) {
+    MemoryManager memoryManager(8, std::move(policy));
+    memoryManager.initialize(workload.arenaWords, mode);
+    memoryManager.setHardening(hardening);
+    if (profileSampleBytes > 0) {
+        memoryManager.startProfiling(profileSampleBytes);
+    }
+
+    std::vector<void*> blocks(workload.events.size(), nullptr);
+    size_t failures = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Event& event : workload.events) {
+        if (event.isAllocate) {
+            blocks[event.id] = memoryManager.allocate(event.sizeInWords * 8);
+            if (blocks[event.id] == nullptr) {
+                ++failures;
+            }
+        }
+        else {
+            memoryManager.free(blocks[event.id]);
+            blocks[event.id] = nullptr;
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    MemoryStats stats = memoryManager.getStats();
+
+    Result result;
+    result.failures = failures;
+    result.internalFragmentation = stats.internalFragmentation;
+    result.externalFragmentation = stats.externalFragmentation;
+    result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / workload.events.size();
+    memoryManager.shutdown();
+    return result;
+}
+
+// Million allocate/free pairs per second with `threads` threads each
+// holding a few live 16 byte blocks at a time
+double contention(size_t threads, bool smallClass) {
+    const size_t kPairs = 200000;
+    const size_t kLive = 4;
+
+    MemoryManager memoryManager(8, std::unique_ptr<PlacementPolicy>(new BestFitPolicy()));
+    memoryManager.initialize(65536);
+    if (smallClass) {
+        memoryManager.enableSmallClass(16, 4096);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&memoryManager]() {
+            void* live[kLive] = {};
+            for (size_t i = 0; i < kPairs; ++i) {
+                memoryManager.free(live[i % kLive]);
+                live[i % kLive] = memoryManager.allocate(16);
+            }
+            for (void* block : live) {
+                memoryManager.free(block);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    memoryManager.shutdown();
+    return threads * kPairs / std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+struct Startup {
+    double initializeMs;
+    double firstTouchMs; // writing one byte per page of every block, as the first requests would
+    double zeroedNsPerOp; // allocateZeroed() of one 4 KiB block out of the fresh arena
+};
+
+// A 128 MiB arena: the most words initialize() takes, 2 KiB each
+Startup startup(const InitOptions& options) {
+    const unsigned kWordSize = 2048;
+    const size_t kWords = 65536;
+    const size_t kBlockWords = 1024;
+    const size_t kPage = 4096;
+    Startup result;
+
+    MemoryManager memoryManager(kWordSize, std::unique_ptr<PlacementPolicy>(new FirstFitPolicy()));
+    auto start = std::chrono::steady_clock::now();
+    memoryManager.initialize(kWords, options);
+    auto initialized = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kWords / kBlockWords / 2; ++i) {
+        char* block = static_cast<char*>(memoryManager.allocate(kBlockWords * kWordSize));
+        for (size_t byte = 0; byte < kBlockWords * kWordSize; byte += kPage) {
+            block[byte] = 1;
+        }
+    }
+    auto touched = std::chrono::steady_clock::now();
+    size_t zeroed = 0;
+    while (memoryManager.allocateZeroed(kPage) != nullptr) {
+        ++zeroed;
+    }
+    auto filled = std::chrono::steady_clock::now();
+    memoryManager.shutdown();
+
+    result.initializeMs = std::chrono::duration<double, std::milli>(initialized - start).count();
+    result.firstTouchMs = std::chrono::duration<double, std::milli>(touched - initialized).count();
+    result.zeroedNsPerOp = std::chrono::duration<double, std::nano>(filled - touched).count() / zeroed;
+    return result;
+}
+
+// Nanoseconds per insert, teardown included, for a vector and a hash map
+// filled from empty on `resource`
+std::pair<double, double> containerInserts(std::pmr::memory_resource* resource) {
+    const size_t kRounds = 20;
+    const size_t kVectorInserts = 20000;
+    const size_t kMapInserts = 8000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < kRounds; ++round) {
+        std::pmr::vector<uint64_t> vector(resource);
+        for (size_t i = 0; i < kVectorInserts; ++i) {
+            vector.push_back(i);
+        }
+    }
+    auto vectors = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < kRounds; ++round) {
+        std::pmr::unordered_map<uint32_t, uint32_t> map(resource);
+        for (uint32_t i = 0; i < kMapInserts; ++i) {
+            map.emplace(i * 2654435761u, i);
+        }
+    }
+    auto maps = std::chrono::steady_clock::now();
+
+    return std::make_pair(std::chrono::duration<double, std::nano>(vectors - start).count() / (kRounds * kVectorInserts),
+                          std::chrono::duration<double, std::nano>(maps - vectors).count() / (kRounds * kMapInserts));
+}
+
+struct PolicyFactory {
+    const char* name;
+    std::unique_ptr<PlacementPolicy> (*make)();
+    AllocationMode mode;
+};
+
+int main(int argc, char** argv) {
+    std::vector<Workload> workloads{smallBursts(), largeBuffers(), frameSlots(), powerOfTwoBuffers()};
+
+    // Enough rounds that building the traces is noise in the counters
+    if (argc > 1 && std::strcmp(argv[1], "replay") == 0) {
+        const size_t kRounds = 20;
+        size_t operations = 0;
+        for (size_t round = 0; round < kRounds; ++round) {
+            for (const Workload& workload : workloads) {
+                replay(workload, std::unique_ptr<PlacementPolicy>(new BestFitPolicy()), AllocationMode::Placement);
+                operations += workload.events.size();
+            }
+        }
+        std::printf("%zu\n", operations);
+        return 0;
+    }
+    std::vector<PolicyFactory> policies{
+        {"bestFit", [] { return std::unique_ptr<PlacementPolicy>(new BestFitPolicy()); }, AllocationMode::Placement},
+        {"worstFit", [] { return std::unique_ptr<PlacementPolicy>(new WorstFitPolicy()); }, AllocationMode::Placement},
+        {"firstFit", [] { return std::unique_ptr<PlacementPolicy>(new FirstFitPolicy()); }, AllocationMode::Placement},
+        {"nextFit", [] { return std::unique_ptr<PlacementPolicy>(new NextFitPolicy()); }, AllocationMode::Placement},
+        {"adaptive", [] { return std::unique_ptr<PlacementPolicy>(new AdaptivePolicy()); }, AllocationMode::Placement},
+        {"buddy", [] { return std::unique_ptr<PlacementPolicy>(); }, AllocationMode::Buddy},
+    };
+
+    std::printf("%-14s %-10s %10s %10s %10s %10s\n", "workload", "policy", "failures", "int frag", "ext frag", "ns/op");
+    for (const Workload& workload : workloads) {
+        for (const PolicyFactory& policy : policies) {
+            Result result = replay(workload, policy.make(), policy.mode);
+            std::printf("%-14s %-10s %10zu %10.3f %10.3f %10.1f\n", workload.name.c_str(), policy.name,
+                        result.failures, result.internalFragmentation, result.externalFragmentation, result.nsPerOp);
+        }
+    }
+
+    std::printf("\n%-8s %14s %14s\n", "threads", "mutex Mops/s", "lock-free");
+    for (size_t threads = 1; threads <= 8; threads *= 2) {
+        std::printf("%-8zu %14.2f %14.2f\n", threads, contention(threads, false), contention(threads, true));
+    }
+
+    std::printf("\n%-14s %-10s %10s %10s\n", "workload", "hardening", "failures", "ns/op");
+    for (const Workload& workload : workloads) {
+        for (unsigned sampleRate : {0u, 1024u, 64u, 1u}) {
+            HardeningOptions hardening;
+            hardening.enabled = sampleRate > 0;
+            hardening.sampleRate = sampleRate;
+            Result result = replay(workload, std::unique_ptr<PlacementPolicy>(new BestFitPolicy()),
+                                   AllocationMode::Placement, hardening);
+            std::string label = sampleRate ? "1/" + std::to_string(sampleRate) : "off";
+            std::printf("%-14s %-10s %10zu %10.1f\n", workload.name.c_str(), label.c_str(), result.failures, result.nsPerOp);
+        }
+    }
+
+    std::printf("\n%-14s %-10s %10s\n", "workload", "profiling", "ns/op");
+    for (const Workload& workload : workloads) {
+        for (size_t sampleBytes : {size_t(0), size_t(512 * 1024), size_t(64 * 1024), size_t(4096)}) {
+            Result result = replay(workload, std::unique_ptr<PlacementPolicy>(new BestFitPolicy()),
+                                   AllocationMode::Placement, HardeningOptions(), sampleBytes);
+            std::string label = sampleBytes ? "1/" + std::to_string(sampleBytes / 1024) + "KiB" : "off";
+            std::printf("%-14s %-10s %10.1f\n", workload.name.c_str(), label.c_str(), result.nsPerOp);
+        }
+    }
+
+    std::printf("\n%-18s %10s %14s %14s\n", "startup", "init ms", "first touch ms", "zeroed ns/op");
+    for (unsigned zeroThreads : {0u, 1u, 4u}) {
+        for (bool prefault : {false, true}) {
+            InitOptions options;
+            options.prefault = prefault;
+            options.zeroThreads = zeroThreads;
+            Startup result = startup(options);
+            std::string label = std::string(prefault ? "prefault" : "lazy") +
+                                (zeroThreads ? ", zero x" + std::to_string(zeroThreads) : "");
+            std::printf("%-18s %10.2f %14.2f %14.1f\n", label.c_str(), result.initializeMs, result.firstTouchMs,
+                        result.zeroedNsPerOp);
+        }
+    }
+
+    std::printf("\n%-18s %14s %14s\n", "pmr inserts", "vector ns/op", "map ns/op");
+    std::pair<double, double> heap = containerInserts(std::pmr::new_delete_resource());
+    std::printf("%-18s %14.1f %14.1f\n", "new/delete", heap.first, heap.second);
+    {
+        MemoryManager memoryManager(16, std::unique_ptr<PlacementPolicy>(new FirstFitPolicy()));
+        memoryManager.initialize(65536);
+        MemoryManagerResource resource(memoryManager);
+        std::pair<double, double> arena = containerInserts(&resource);
+        std::printf("%-18s %14.1f %14.1f\n", "arena", arena.first, arena.second);
+        memoryManager.shutdown();
+    }
+
+    return 0;
+}